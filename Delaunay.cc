@@ -1,212 +1,333 @@
-// Robust version of Gilles Dumoulin's C++ port of Paul Bourke's
-// triangulation code available from
-// http://astronomy.swin.edu.au/~pbourke/papers/triangulate
-// Used with permission of Paul Bourke.
-// Segmentation fault and numerical robustness improvements by John C. Bowman
+// Incremental Delaunay triangulation with the robust predicates of
+// predicates.cc.
+//
+// The points are inserted in the order of a Hilbert curve through their
+// bounding box, so that each point is located by a short walk from the last
+// triangle created. The triangles in conflict with the point (those whose
+// circumcircle contains it) are replaced by a fan of triangles about it
+// (Bowyer-Watson). The convex hull is closed off by ghost triangles sharing
+// a vertex at infinity, so no bounding triangle is needed: a ghost triangle
+// is in conflict with the points strictly outside its hull edge or inside
+// it. Time is O(n log n) for well-distributed points and memory is linear.
+
+#include <algorithm>
+#include <vector>
 
-#include <cassert>
 #include "Delaunay.h"
 #include "predicates.h"
 
-inline double max(double a, double b)
+namespace {
+
+// The vertex at infinity.
+const Int ghost=-1;
+
+// A triangle a,b,c in counterclockwise order, with n[i] the triangle across
+// the edge opposite vertex i. In a ghost triangle, c is the ghost vertex and
+// a,b is a hull edge traversed clockwise about the hull.
+struct triangle {
+  Int v[3];
+  Int n[3];
+  unsigned stamp;
+};
+
+inline Int next(Int i)
 {
-  return (a > b) ? a : b;
+  return i == 2 ? 0 : i+1;
 }
 
-int XYZCompare(const void *v1, const void *v2) 
+inline Int prev(Int i)
 {
-  double x1=((XYZ*)v1)->p[0];
-  double x2=((XYZ*)v2)->p[0];
-  if(x1 < x2)
-    return(-1);
-  else if(x1 > x2)
-    return(1);
-  else
-    return(0);
+  return i == 0 ? 2 : i-1;
 }
 
-inline double hypot2(double *x)
+// Return the index of the point (x,y), quantized to 32 bits per coordinate,
+// along a Hilbert curve through the unit square.
+unsigned long long hilbert(unsigned long long x, unsigned long long y)
 {
-  return x[0]*x[0]+x[1]*x[1];
+  unsigned long long d=0;
+  for(unsigned long long s=1ULL << 31; s > 0; s >>= 1) {
+    unsigned long long rx=(x & s) > 0;
+    unsigned long long ry=(y & s) > 0;
+    d += s*s*((3*rx) ^ ry);
+    if(ry == 0) {
+      if(rx == 1) {
+        x=s-1-x;
+        y=s-1-y;
+      }
+      std::swap(x,y);
+    }
+  }
+  return d;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-// Triangulate():
-//   Triangulation subroutine
-//   Takes as input NV vertices in array pxyz
-//   Returned is a list of ntri triangular faces in the array v
-//   These triangles are arranged in a consistent clockwise order.
-//   The triangle array v should be allocated to 4 * nv
-//   The vertex array pxyz must be big enough to hold 3 additional points.
-//   By default, the array pxyz is automatically presorted and postsorted.
-///////////////////////////////////////////////////////////////////////////////
-
-Int Triangulate(Int nv, XYZ pxyz[], ITRIANGLE v[], Int &ntri,
-                bool presort, bool postsort)
-{
-  Int emax = 200;
-
-  if(presort) qsort(pxyz,nv,sizeof(XYZ),XYZCompare);
-  else postsort=false;
-  
-/* Allocate memory for the completeness list, flag for each triangle */
-  Int trimax = 4 * nv;
-  Int *complete = new Int[trimax];
-/* Allocate memory for the edge list */
-  IEDGE *edges = new IEDGE[emax];
-/*
-  Find the maximum and minimum vertex bounds.
-  This is to allow calculation of the bounding triangle
-*/
-  double xmin = pxyz[0].p[0];
-  double ymin = pxyz[0].p[1];
-  double xmax = xmin;
-  double ymax = ymin;
-  for(Int i = 1; i < nv; i++) {
-    XYZ *pxyzi=pxyz+i;
-    double x=pxyzi->p[0];
-    double y=pxyzi->p[1];
-    if (x < xmin) xmin = x;
-    if (x > xmax) xmax = x;
-    if (y < ymin) ymin = y;
-    if (y > ymax) ymax = y;
+struct hilbertKey {
+  unsigned long long key;
+  Int i;
+  bool operator < (const hilbertKey& other) const {
+    return key < other.key;
   }
-  double dx = xmax - xmin;
-  double dy = ymax - ymin;
-/*
-  Set up the supertriangle.
-  This is a triangle which encompasses all the sample points.
-  The supertriangle coordinates are added to the end of the
-  vertex list. The supertriangle is the first triangle in
-  the triangle list.
-*/
-  static const double margin=0.01;
-  double xmargin=margin*dx;
-  double ymargin=margin*dy;
-  pxyz[nv+0].p[0] = xmin-xmargin;
-  pxyz[nv+0].p[1] = ymin-ymargin;
-  pxyz[nv+1].p[0] = xmin-xmargin;
-  pxyz[nv+1].p[1] = ymax+ymargin+dx;
-  pxyz[nv+2].p[0] = xmax+xmargin+dy;
-  pxyz[nv+2].p[1] = ymin-ymargin;
-  v->p1 = nv;
-  v->p2 = nv+1;
-  v->p3 = nv+2;
-  complete[0] = false;
-  ntri = 1;
-/*
-  Include each point one at a time into the existing mesh
-*/
-  for(Int i = 0; i < nv; i++) {
-    Int nedge = 0;
-    double *d=pxyz[i].p;
-/*
-  Set up the edge buffer.
-  If the point d lies inside the circumcircle then the
-  three edges of that triangle are added to the edge buffer
-  and that triangle is removed.
-*/
-    for(Int j = 0; j < ntri; j++) {
-      if(complete[j])
-        continue;
-      ITRIANGLE *vj=v+j;
-
-      double *a=pxyz[vj->p1].p;
-      double *b=pxyz[vj->p2].p;
-      double *c=pxyz[vj->p3].p;
-      
-      if(incircle(a,b,c,d) <= 0.0) { // Point d is inside or on circumcircle
-/* Check that we haven't exceeded the edge list size */
-        if(nedge + 3 >= emax) {
-          emax += 100;
-          IEDGE *p_EdgeTemp = new IEDGE[emax];
-          for (Int i = 0; i < nedge; i++) {
-            p_EdgeTemp[i] = edges[i];   
-          }
-          delete[] edges;
-          edges = p_EdgeTemp;
-        }
-        ITRIANGLE *vj=v+j;
-        Int p1=vj->p1;
-        Int p2=vj->p2;
-        Int p3=vj->p3;
-        edges[nedge].p1 = p1;
-        edges[nedge].p2 = p2;
-        edges[++nedge].p1 = p2;
-        edges[nedge].p2 = p3;
-        edges[++nedge].p1 = p3;
-        edges[nedge].p2 = p1;
-        ++nedge;
-        ntri--;
-        v[j] = v[ntri];
-        complete[j] = complete[ntri];
-        j--;
-      } else {
-        double A=hypot2(a);
-        double B=hypot2(b);
-        double C=hypot2(c);
-        double a0=orient2d(a,b,c);
-        // Is d[0] > xc+r for circumcircle abc of radius r about (xc,yc)?
-        if(d[0]*a0 < 0.5*orient2d(A,a[1],B,b[1],C,c[1]))
-          complete[j]=
-            incircle(a[0]*a0,a[1]*a0,b[0]*a0,b[1]*a0,c[0]*a0,c[1]*a0,
-                     d[0]*a0,0.5*orient2d(a[0],A,b[0],B,c[0],C)) > 0.0;
-      }
+};
+
+class delaunay {
+  const XYZ *pxyz;
+  std::vector<triangle> t;
+  Int last;           // A recently created finite triangle.
+  unsigned stamp;     // Marks the triangles in the current cavity.
+
+  // Scratch space for an insertion.
+  std::vector<Int> stack,cavity,boundary,link;
+
+  const double *point(Int i) const {
+    return pxyz[i].p;
+  }
+
+  bool conflict(Int k, const double *p) const {
+    const Int *v=t[k].v;
+    const double *a=point(v[0]);
+    const double *b=point(v[1]);
+    if(v[2] == ghost) {
+      double o=orient2d(a,b,p);
+      if(o != 0.0) return o > 0.0;
+      // The point lies on the line through the hull edge; it is in conflict
+      // if it lies strictly within the edge.
+      double dx=b[0]-a[0], dy=b[1]-a[1];
+      return (p[0]-a[0])*dx+(p[1]-a[1])*dy > 0.0 &&
+        (b[0]-p[0])*dx+(b[1]-p[1])*dy > 0.0;
     }
-/*
-  Tag multiple edges
-  Note: if all triangles are specified anticlockwise then all
-  interior edges are opposite pointing in direction.
-*/
-    for(Int j = 0; j < nedge - 1; j++) {
-      for(Int k = j + 1; k < nedge; k++) {
-        if((edges[j].p1 == edges[k].p2) && (edges[j].p2 == edges[k].p1)) {
-          edges[j].p1 = -1;
-          edges[j].p2 = -1;
-          edges[k].p1 = -1;
-          edges[k].p2 = -1;
-        }
+    return incircle(a,b,point(v[2]),p) > 0.0;
+  }
+
+  Int add(Int a, Int b, Int c) {
+    triangle T={{a,b,c},{-1,-1,-1},0};
+    t.push_back(T);
+    return (Int) t.size()-1;
+  }
+
+  // Return a triangle in conflict with p, or -1 if p is a vertex.
+  Int locate(const double *p) const;
+
+public:
+  delaunay(Int nv, const XYZ *pxyz) : pxyz(pxyz), last(0), stamp(0),
+                                      link(nv+1) {
+    t.reserve(2*nv+2);
+  }
+
+  // Start with the counterclockwise triangle a,b,c.
+  void start(Int a, Int b, Int c);
+
+  void insert(Int i);
+
+  // Store the finite triangles in clockwise order.
+  Int triangles(ITRIANGLE *V, bool postsort) const;
+};
+
+void delaunay::start(Int a, Int b, Int c)
+{
+  Int k=add(a,b,c);
+  Int ga=add(c,b,ghost);  // Across the edge opposite a.
+  Int gb=add(a,c,ghost);
+  Int gc=add(b,a,ghost);
+  triangle& T=t[k];
+  T.n[0]=ga; T.n[1]=gb; T.n[2]=gc;
+  // The ghost triangle x,y across a hull edge y,x adjoins the ghost triangle
+  // starting at y across the edge y,ghost and the one ending at x across the
+  // edge ghost,x.
+  t[ga].n[0]=gc; t[ga].n[1]=gb; t[ga].n[2]=k;
+  t[gb].n[0]=ga; t[gb].n[1]=gc; t[gb].n[2]=k;
+  t[gc].n[0]=gb; t[gc].n[1]=ga; t[gc].n[2]=k;
+  last=k;
+}
+
+Int delaunay::locate(const double *p) const
+{
+  Int k=last;
+  unsigned r=0;
+  for(;;) {
+    const triangle& T=t[k];
+    if(T.v[2] == ghost) return k;
+    // Step across the first edge that p lies strictly beyond, starting from
+    // a varying edge so that the walk cannot cycle.
+    Int step=-1;
+    r=r*1103515245+12345;
+    Int i0=(r >> 16) % 3;
+    for(Int j=0, i=i0; j < 3; ++j, i=next(i)) {
+      if(orient2d(point(T.v[next(i)]),point(T.v[prev(i)]),p) < 0.0) {
+        step=i;
+        break;
       }
     }
-/*
-  Form new triangles for the current point
-  Skipping over any tagged edges.
-  All edges are arranged in clockwise order.
-*/
-    for(Int j = 0; j < nedge; j++) {
-      if(edges[j].p1 < 0 || edges[j].p2 < 0)
-        continue;
-      v[ntri].p1 = edges[j].p1;
-      v[ntri].p2 = edges[j].p2;
-      v[ntri].p3 = i;
-      complete[ntri] = false;
-      ntri++;
-      assert(ntri < trimax);
+    if(step < 0) {
+      for(Int i=0; i < 3; ++i) {
+        const double *v=point(T.v[i]);
+        if(v[0] == p[0] && v[1] == p[1]) return -1;
+      }
+      return k;
     }
+    k=T.n[step];
   }
-/*
-  Remove triangles with supertriangle vertices
-  These are triangles which have a vertex number greater than nv
-*/
-  for(Int i = 0; i < ntri; i++) {
-    ITRIANGLE *vi=v+i;
-    if(vi->p1 >= nv || vi->p2 >= nv || vi->p3 >= nv) {
-      ntri--;
-      *vi = v[ntri];
-      i--;
+}
+
+void delaunay::insert(Int i)
+{
+  const double *p=point(i);
+  Int k=locate(p);
+  if(k < 0) return;
+
+  // Collect the cavity of triangles in conflict with p and its boundary, as
+  // triples of a cavity triangle, the index of the boundary edge in it, and
+  // the index of the same edge in the triangle across it.
+  ++stamp;
+  stack.clear();
+  cavity.clear();
+  boundary.clear();
+  t[k].stamp=stamp;
+  stack.push_back(k);
+  while(!stack.empty()) {
+    Int s=stack.back();
+    stack.pop_back();
+    cavity.push_back(s);
+    for(Int j=0; j < 3; ++j) {
+      Int nb=t[s].n[j];
+      if(t[nb].stamp == stamp) continue;
+      if(conflict(nb,p)) {
+        t[nb].stamp=stamp;
+        stack.push_back(nb);
+      } else {
+        const Int *n=t[nb].n;
+        boundary.push_back(s);
+        boundary.push_back(j);
+        boundary.push_back(n[0] == s ? 0 : n[1] == s ? 1 : 2);
+      }
     }
   }
-  delete[] edges;
-  delete[] complete;
-
-  if(postsort) { 
-    for(Int i = 0; i < ntri; i++) {
-      ITRIANGLE *vi=v+i;
-      vi->p1=pxyz[vi->p1].i;
-      vi->p2=pxyz[vi->p2].i;
-      vi->p3=pxyz[vi->p3].i;
+
+  // Replace the cavity by a fan of triangles u,w,p about p, one for each
+  // boundary edge u,w, reusing the cavity triangles first.
+  size_t m=boundary.size()/3;
+  size_t nc=cavity.size();
+  for(size_t e=0; e < m; ++e) {
+    Int s=boundary[3*e];
+    Int j=boundary[3*e+1];
+    Int u=t[s].v[next(j)];
+    Int w=t[s].v[prev(j)];
+    Int nb=t[s].n[j];
+    Int k=e < nc ? cavity[e] : add(0,0,0);
+    t[nb].n[boundary[3*e+2]]=k;
+    boundary[3*e]=k;
+    boundary[3*e+1]=nb;
+    link[u == ghost ? link.size()-1 : u]=k;
+    stack.push_back(u);
+    stack.push_back(w);
+  }
+
+  for(size_t e=0; e < m; ++e) {
+    Int k=boundary[3*e];
+    Int u=stack[2*e];
+    Int w=stack[2*e+1];
+    triangle& T=t[k];
+    T.v[0]=u; T.v[1]=w; T.v[2]=i;
+    T.n[0]=link[w == ghost ? link.size()-1 : w];
+    T.n[2]=boundary[3*e+1];
+    T.stamp=0;
+  }
+  for(size_t e=0; e < m; ++e) {
+    Int k=boundary[3*e];
+    t[t[k].n[0]].n[1]=k;
+  }
+
+  // Rotate the new ghost triangles so that the ghost vertex comes last.
+  for(size_t e=0; e < m; ++e) {
+    Int k=boundary[3*e];
+    triangle& T=t[k];
+    if(T.v[0] == ghost || T.v[1] == ghost) {
+      Int r=T.v[0] == ghost ? 1 : 2;
+      Int v[3],n[3];
+      for(Int l=0; l < 3; ++l) {
+        v[l]=T.v[(l+r) % 3];
+        n[l]=T.n[(l+r) % 3];
+      }
+      for(Int l=0; l < 3; ++l) {
+        T.v[l]=v[l];
+        T.n[l]=n[l];
+      }
+    } else last=k;
+  }
+  stack.clear();
+}
+
+Int delaunay::triangles(ITRIANGLE *V, bool postsort) const
+{
+  Int ntri=0;
+  for(size_t k=0; k < t.size(); ++k) {
+    const triangle& T=t[k];
+    if(T.v[2] == ghost) continue;
+    ITRIANGLE *Vk=V+ntri;
+    Vk->p1=T.v[0];
+    Vk->p2=T.v[2];
+    Vk->p3=T.v[1];
+    if(postsort) {
+      Vk->p1=pxyz[Vk->p1].i;
+      Vk->p2=pxyz[Vk->p2].i;
+      Vk->p3=pxyz[Vk->p3].i;
     }
+    ++ntri;
   }
+  return ntri;
+}
+
+}
+
+Int Triangulate(Int nv, const XYZ pxyz[], ITRIANGLE v[], Int &ntri,
+                bool postsort)
+{
+  ntri=0;
+  if(nv < 3) return 0;
 
+  double xmin=pxyz[0].p[0];
+  double ymin=pxyz[0].p[1];
+  double xmax=xmin;
+  double ymax=ymin;
+  for(Int i=1; i < nv; i++) {
+    double x=pxyz[i].p[0];
+    double y=pxyz[i].p[1];
+    if(x < xmin) xmin=x;
+    if(x > xmax) xmax=x;
+    if(y < ymin) ymin=y;
+    if(y > ymax) ymax=y;
+  }
+
+  // Order the points along a Hilbert curve.
+  double scale=std::max(xmax-xmin,ymax-ymin);
+  scale=scale > 0.0 ? 4294967295.0/scale : 0.0;
+  std::vector<hilbertKey> order(nv);
+  for(Int i=0; i < nv; i++) {
+    order[i].key=hilbert((unsigned long long) ((pxyz[i].p[0]-xmin)*scale),
+                         (unsigned long long) ((pxyz[i].p[1]-ymin)*scale));
+    order[i].i=i;
+  }
+  std::sort(order.begin(),order.end());
+
+  // Start with the first three points in order that are not collinear.
+  Int a=order[0].i;
+  Int j=1;
+  while(j < nv && pxyz[order[j].i].p[0] == pxyz[a].p[0] &&
+        pxyz[order[j].i].p[1] == pxyz[a].p[1]) ++j;
+  if(j == nv) return 0;
+  Int b=order[j].i;
+  Int k=j+1;
+  double o=0.0;
+  for(; k < nv; ++k)
+    if((o=orient2d(pxyz[a].p,pxyz[b].p,pxyz[order[k].i].p)) != 0.0) break;
+  if(k == nv) return 0;
+  Int c=order[k].i;
+
+  delaunay D(nv,pxyz);
+  if(o > 0.0) D.start(a,b,c);
+  else D.start(a,c,b);
+
+  for(Int i=1; i < nv; ++i)
+    if(i != j && i != k) D.insert(order[i].i);
+
+  ntri=D.triangles(v,postsort);
   return 0;
-} 
+}
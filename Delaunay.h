@@ -21,8 +21,13 @@ struct XYZ{
   Int i;
 };
 
-Int Triangulate(Int nv, XYZ pxyz[], ITRIANGLE v[], Int &ntri,
-                bool presort=true, bool postsort=true);
+// Compute the Delaunay triangulation of the nv points pxyz, storing in v
+// the ntri triangles, each in clockwise order, as indices into pxyz (or, if
+// postsort, as the corresponding values of pxyz[].i). Repeated points are
+// used once; collinear points yield no triangles. The array v must have room
+// for 2*nv triangles.
+Int Triangulate(Int nv, const XYZ pxyz[], ITRIANGLE v[], Int &ntri,
+                bool postsort=true);
 
 #endif
 
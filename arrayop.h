@@ -24,6 +24,41 @@ using camp::tab;
 
 vm::array *copyArray(vm::array *a);
 vm::array *copyArray2(vm::array *a);
+
+// A read-only view of an array as a contiguous buffer of unboxed values.
+// In COMPACT mode an initialized real or integer item is just its value, so
+// once every element is known to be initialized the view aliases the array
+// storage directly; other element types are unboxed into a temporary copy.
+template<class T>
+class unboxedArray {
+  const T *data;
+  T *copy;
+
+  unboxedArray(const unboxedArray&);
+  unboxedArray& operator=(const unboxedArray&);
+public:
+  unboxedArray(const vm::array *a) : data(NULL), copy(NULL) {
+    size_t size=checkArray(a);
+#if COMPACT
+    if(sizeof(T) == sizeof(vm::item)) {
+      for(size_t i=0; i < size; i++)
+        if((*a)[i].empty()) throw vm::bad_item_value();
+      if(size) data=reinterpret_cast<const T*>(&(*a)[0]);
+      return;
+    }
+#endif
+    copy=new T[size];
+    for(size_t i=0; i < size; i++)
+      copy[i]=vm::read<T>(a,i);
+    data=copy;
+  }
+
+  ~unboxedArray() {
+    delete[] copy;
+  }
+
+  const T& operator[](size_t i) const {return data[i];}
+};
   
 template<class T, class U, template <class S> class op>
 void arrayOp(vm::stack *s)
@@ -66,9 +101,10 @@ void sumArray(vm::stack *s)
 {
   array *a=pop<array*>(s);
   size_t size=checkArray(a);
+  unboxedArray<T> A(a);
   T sum=0;
   for(size_t i=0; i < size; i++)
-    sum += read<T>(a,i);
+    sum += A[i];
   s->push(sum);
 }
 
@@ -540,6 +576,31 @@ inline void copyArrayC(T* &dest, const vm::array *a, T (*cast)(A),
     dest[i]=cast(vm::read<A>(a,i));
 }
 
+inline void appendCoordinates(std::vector<double>& x, const camp::pair& z)
+{
+  x.push_back(z.getx());
+  x.push_back(z.gety());
+}
+
+inline void appendCoordinates(std::vector<double>& x, const camp::triple& z)
+{
+  x.push_back(z.getx());
+  x.push_back(z.gety());
+  x.push_back(z.getz());
+}
+
+// Return the coordinates of the pairs or triples of a, stored consecutively.
+template<class T>
+inline std::vector<double> coordinates(const vm::array *a)
+{
+  size_t n=checkArray(a);
+  std::vector<double> x;
+  x.reserve(sizeof(T)/sizeof(double)*n);
+  for(size_t i=0; i < n; ++i)
+    appendCoordinates(x,vm::read<T>(a,i));
+  return x;
+}
+
 template<typename T>
 inline vm::array* copyCArray(const size_t n, const T* p)
 {
@@ -6,10 +6,11 @@
  *****/
 
 #include "beziercurve.h"
+#include "swrender.h"
 
 namespace camp {
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 
 std::vector<GLfloat> BezierCurve::buffer;
 std::vector<GLuint> BezierCurve::indices;
@@ -74,12 +75,21 @@ void BezierCurve::render(const triple *p, bool straight)
   
 void BezierCurve::draw()
 {
+  if(software) {
+    if(!indices.empty())
+      software->lines(&buffer[0],&indices[0],indices.size());
+    clear();
+    return;
+  }
+  
+#ifdef HAVE_GL
   size_t stride=3*sizeof(GLfloat);
 
   glEnableClientState(GL_VERTEX_ARRAY);
   glVertexPointer(3,GL_FLOAT,stride,&buffer[0]);
   glDrawElements(GL_LINES,indices.size(),GL_UNSIGNED_INT,&indices[0]);
   glDisableClientState(GL_VERTEX_ARRAY);
+#endif
   clear();
 }
 
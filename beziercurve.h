@@ -12,7 +12,7 @@
 
 namespace camp {
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 
 extern const double Fuzz;
 extern const double Fuzz2;
@@ -7,6 +7,7 @@
 
 #include "bezierpatch.h"
 #include "predicates.h"
+#include "swrender.h"
 
 namespace camp {
 
@@ -17,16 +18,16 @@ size_t tstride;
 
 double viewpoint[3];
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 
-std::vector<GLfloat> BezierPatch::buffer;
-std::vector<GLfloat> BezierPatch::Buffer;
-std::vector<GLuint> BezierPatch::indices;
-std::vector<GLuint> BezierPatch::Indices;
-std::vector<GLfloat> BezierPatch::tbuffer;
-std::vector<GLuint> BezierPatch::tindices;
-std::vector<GLfloat> BezierPatch::tBuffer;
-std::vector<GLuint> BezierPatch::tIndices;
+thread_local std::vector<GLfloat> BezierPatch::buffer;
+thread_local std::vector<GLfloat> BezierPatch::Buffer;
+thread_local std::vector<GLuint> BezierPatch::indices;
+thread_local std::vector<GLuint> BezierPatch::Indices;
+thread_local std::vector<GLfloat> BezierPatch::tbuffer;
+thread_local std::vector<GLuint> BezierPatch::tindices;
+thread_local std::vector<GLfloat> BezierPatch::tBuffer;
+thread_local std::vector<GLuint> BezierPatch::tIndices;
 
 std::vector<GLuint>& I=BezierPatch::tIndices;
 std::vector<GLfloat>& V=BezierPatch::tBuffer;
@@ -63,10 +64,10 @@ struct iz {
 
 std::vector<iz> IZ;
 
-GLuint BezierPatch::nvertices=0;
-GLuint BezierPatch::ntvertices=0;
-GLuint BezierPatch::Nvertices=0;
-GLuint BezierPatch::Ntvertices=0;
+thread_local GLuint BezierPatch::nvertices=0;
+thread_local GLuint BezierPatch::ntvertices=0;
+thread_local GLuint BezierPatch::Nvertices=0;
+thread_local GLuint BezierPatch::Ntvertices=0;
 
 extern const double Fuzz2;
 
@@ -198,55 +199,73 @@ unsigned n;
 unsigned int count;
 const size_t nbuffer=10000;
   
-// Sort nonintersecting triangles by depth.
-int compare(const void *p, const void *P)
+// Sort nonintersecting triangles by depth, the sum of the depths of their
+// vertices, with a stable least-significant-digit radix sort. The bits of
+// each depth are mapped to an unsigned integer key in the same order.
+std::vector<unsigned> keys,Keys;
+std::vector<GLuint> order,Order;
+std::vector<GLuint> sorted;
+
+const unsigned radixbits=11;
+const unsigned radix=1 << radixbits;
+
+inline unsigned depthkey(float z)
 {
-  unsigned Ia=((GLuint *) p)[0];
-  unsigned Ib=((GLuint *) p)[1];
-  unsigned Ic=((GLuint *) p)[2];
+  unsigned u;
+  memcpy(&u,&z,sizeof(unsigned));
+  return u & 0x80000000U ? ~u : u | 0x80000000U;
+}
 
-  unsigned IA=((GLuint *) P)[0];
-  unsigned IB=((GLuint *) P)[1];
-  unsigned IC=((GLuint *) P)[2];
+void depthsort(std::vector<GLuint>& I)
+{
+  size_t n=I.size()/3;
+  if(n == 0) return;
   
-  return zbuffer[Ia]+zbuffer[Ib]+zbuffer[Ic] < 
-    zbuffer[IA]+zbuffer[IB]+zbuffer[IC] ? -1 : 1;
+  keys.resize(n);
+  Keys.resize(n);
+  order.resize(n);
+  Order.resize(n);
   
-  /*
-  double a[]={xbuffer[Ia],ybuffer[Ia],zbuffer[Ia]};
-  double b[]={xbuffer[Ib],ybuffer[Ib],zbuffer[Ib]};
-  double c[]={xbuffer[Ic],ybuffer[Ic],zbuffer[Ic]};
-      
-  double A[]={xbuffer[IA],ybuffer[IA],zbuffer[IA]};
-  double B[]={xbuffer[IB],ybuffer[IB],zbuffer[IB]};
-  double C[]={xbuffer[IC],ybuffer[IC],zbuffer[IC]};
-
-  double viewpoint[]={0,0,100000};
+  for(size_t i=0; i < n; ++i) {
+    size_t i3=3*i;
+    keys[i]=depthkey(zbuffer[I[i3]]+zbuffer[I[i3+1]]+zbuffer[I[i3+2]]);
+    order[i]=i;
+  }
   
-  double sa=-orient3d(A,B,C,a);
-  double sb=-orient3d(A,B,C,b);
-  double sc=-orient3d(A,B,C,c);
-  double s=min(sa,sb,sc);
-  double S=max(sa,sb,sc);
-  double eps=1000;
-
-  if(s < -eps && S > eps) { //swap
-    double sA=-orient3d(a,b,c,A);
-    double sB=-orient3d(a,b,c,B);
-    double sC=-orient3d(a,b,c,C);
-    double s=min(sA,sB,sC);
-    double S=max(sA,sB,sC);
-    if(S < -s) S=s;
-    int sz=sgn1(orient3d(a,b,c,viewpoint));
-    if(S < -eps) return -sz;
-    if(S > eps) return sz;
+  size_t count[radix];
+  for(unsigned shift=0; shift < 32; shift += radixbits) {
+    memset(count,0,sizeof(count));
+    for(size_t i=0; i < n; ++i)
+      ++count[(keys[i] >> shift) & (radix-1)];
+    
+    // Skip a digit shared by every key.
+    if(count[(keys[0] >> shift) & (radix-1)] == n) continue;
+    
+    size_t sum=0;
+    for(unsigned d=0; d < radix; ++d) {
+      size_t c=count[d];
+      count[d]=sum;
+      sum += c;
+    }
+    
+    for(size_t i=0; i < n; ++i) {
+      size_t j=count[(keys[i] >> shift) & (radix-1)]++;
+      Keys[j]=keys[i];
+      Order[j]=order[i];
+    }
+    keys.swap(Keys);
+    order.swap(Order);
   }
-  if(S < -s) S=s;
-  int sz=sgn1(orient3d(A,B,C,viewpoint));
-  if(S < -eps) return sz;
-  if(S > eps) return -sz;
-  return a[2]+b[2]+c[2] < A[2]+B[2]+C[2] ? -1 : 1;
-  */
+  
+  sorted.resize(3*n);
+  for(size_t i=0; i < n; ++i) {
+    size_t i3=3*i;
+    size_t j3=3*order[i];
+    sorted[i3]=I[j3];
+    sorted[i3+1]=I[j3+1];
+    sorted[i3+2]=I[j3+2];
+  }
+  I.swap(sorted);
 }
 
 void split(unsigned i3, GLuint ia, GLuint ib, GLuint ic,
@@ -314,25 +333,67 @@ void BezierPatch::init(double res, const triple& Min, const triple& Max,
     tbuffer.reserve(nbuffer);
     tindices.reserve(nbuffer);
     pindices=&tindices;
+    pbuffer=&tbuffer;
+    pnvertices=&ntvertices;
     pvertex=&tvertex;
     if(colors) {
       tBuffer.reserve(nbuffer);
       tIndices.reserve(nbuffer);
       pindices=&tIndices;
+      pbuffer=&tBuffer;
+      pnvertices=&Ntvertices;
       pVertex=&tVertex;
     }
   } else {
     buffer.reserve(nbuffer);
     pindices=&indices;
+    pbuffer=&buffer;
+    pnvertices=&nvertices;
     pvertex=&vertex;
     if(colors) {
       Buffer.reserve(nbuffer);
       Indices.reserve(nbuffer);
       pindices=&Indices;
+      pbuffer=&Buffer;
+      pnvertices=&Nvertices;
       pVertex=&Vertex;
     }
   }
 }
+
+void BezierPatch::queue(const triple *g, bool straight, double ratio,
+                        const triple& Min, const triple& Max,
+                        bool transparent, GLfloat *colors, BezierMesh& mesh)
+{
+  int b=bucket(pixel*ratio);
+  init(exp2(0.25*b),Min,Max,transparent,colors);
+  
+  std::vector<GLfloat>& B=*pbuffer;
+  std::vector<GLuint>& I=*pindices;
+  size_t nbuffer=B.size();
+  size_t nindices=I.size();
+  GLuint offset=*pnvertices;
+  
+  if(mesh.valid && mesh.bucket == b) {
+    B.insert(B.end(),mesh.buffer.begin(),mesh.buffer.end());
+    size_t n=mesh.indices.size();
+    I.resize(nindices+n);
+    for(size_t i=0; i < n; ++i)
+      I[nindices+i]=offset+mesh.indices[i];
+    *pnvertices += mesh.buffer.size()/(colors ? 10 : 6);
+    return;
+  }
+  
+  render(g,straight,colors);
+  
+  mesh.buffer.assign(B.begin()+nbuffer,B.end());
+  size_t n=I.size()-nindices;
+  mesh.indices.resize(n);
+  for(size_t i=0; i < n; ++i)
+    mesh.indices[i]=I[nindices+i]-offset;
+  mesh.bucket=b;
+  mesh.valid=true;
+}
     
 // Use a uniform partition to draw a Bezier patch.
 // p is an array of 16 triples representing the control points.
@@ -886,47 +947,59 @@ void bounds(const std::vector<GLuint>& I)
   }
 }
   
-void BezierPatch::draw()
+void drawBuffer(const GLfloat *buffer, const GLuint *indices, size_t n,
+                bool colors)
 {
-  if(nvertices == 0 && ntvertices == 0 && Nvertices == 0 && Ntvertices == 0)
+  if(software) {
+    software->triangles(buffer,indices,n,colors);
     return;
+  }
+  
+#ifdef HAVE_GL
+  const size_t stride=colors ? 10 : 6;
+  const size_t bytestride=stride*sizeof(GLfloat);
   
-  const size_t stride=6;
-  const size_t Stride=10;
-  const size_t size=sizeof(GLfloat);
-  const size_t bytestride=stride*size;
-  const size_t Bytestride=Stride*size;
-    
   glEnableClientState(GL_NORMAL_ARRAY);
   glEnableClientState(GL_VERTEX_ARRAY);
-  
-  if(nvertices > 0) {
-    glVertexPointer(3,GL_FLOAT,bytestride,&buffer[0]);
-    glNormalPointer(GL_FLOAT,bytestride,&buffer[3]);
-    glDrawElements(GL_TRIANGLES,indices.size(),GL_UNSIGNED_INT,&indices[0]);
-  }
-  
-  if(Nvertices > 0) {
+  if(colors) {
     glEnableClientState(GL_COLOR_ARRAY);
     glEnable(GL_COLOR_MATERIAL);
-    glVertexPointer(3,GL_FLOAT,Bytestride,&Buffer[0]);
-    glNormalPointer(GL_FLOAT,Bytestride,&Buffer[3]);
-    glColorPointer(4,GL_FLOAT,Bytestride,&Buffer[6]);
-    glDrawElements(GL_TRIANGLES,Indices.size(),GL_UNSIGNED_INT,&Indices[0]);
+    glColorPointer(4,GL_FLOAT,bytestride,buffer+6);
+  }
+  glVertexPointer(3,GL_FLOAT,bytestride,buffer);
+  glNormalPointer(GL_FLOAT,bytestride,buffer+3);
+  glDrawElements(GL_TRIANGLES,n,GL_UNSIGNED_INT,indices);
+  if(colors) {
     glDisable(GL_COLOR_MATERIAL);
     glDisableClientState(GL_COLOR_ARRAY);
   }
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+#endif
+}
+
+void BezierPatch::draw()
+{
+  if(nvertices == 0 && ntvertices == 0 && Nvertices == 0 && Ntvertices == 0)
+    return;
+  
+  const size_t stride=6;
+  const size_t Stride=10;
+    
+  if(nvertices > 0)
+    drawBuffer(&buffer[0],&indices[0],indices.size(),false);
+  
+  if(Nvertices > 0)
+    drawBuffer(&Buffer[0],&Indices[0],Indices.size(),true);
   
   if(ntvertices > 0) {
     tstride=stride;
     transform(tbuffer); 
 //    bounds(tindices);
     
-    qsort(&tindices[0],tindices.size()/3,3*sizeof(GLuint),compare);
+    depthsort(tindices);
       
-    glVertexPointer(3,GL_FLOAT,bytestride,&tbuffer[0]);
-    glNormalPointer(GL_FLOAT,bytestride,&tbuffer[3]);
-    glDrawElements(GL_TRIANGLES,tindices.size(),GL_UNSIGNED_INT,&tindices[0]);
+    drawBuffer(&tbuffer[0],&tindices[0],tindices.size(),false);
   }
   
   if(Ntvertices > 0) {
@@ -934,24 +1007,29 @@ void BezierPatch::draw()
     transform(tBuffer);
 //    bounds(tIndices);
     
-    qsort(&tIndices[0],tIndices.size()/3,3*sizeof(GLuint),compare);
+    depthsort(tIndices);
     
-    glEnableClientState(GL_COLOR_ARRAY);
-    glEnable(GL_COLOR_MATERIAL);
-    glVertexPointer(3,GL_FLOAT,Bytestride,&tBuffer[0]);
-    glNormalPointer(GL_FLOAT,Bytestride,&tBuffer[3]);
-    glColorPointer(4,GL_FLOAT,Bytestride,&tBuffer[6]);
-    glDrawElements(GL_TRIANGLES,tIndices.size(),GL_UNSIGNED_INT,&tIndices[0]);
-    glDisable(GL_COLOR_MATERIAL);
-    glDisableClientState(GL_COLOR_ARRAY);
+    drawBuffer(&tBuffer[0],&tIndices[0],tIndices.size(),true);
   }
   
-  glDisableClientState(GL_VERTEX_ARRAY);
-  glDisableClientState(GL_NORMAL_ARRAY);
-  
   clear();
 }
 
+void BezierPatch::draw(const triple *g, bool straight, double ratio,
+                       const triple& Min, const triple& Max, GLfloat *colors,
+                       BezierMesh& mesh)
+{
+  if(!cached(ratio,mesh)) {
+    queue(g,straight,ratio,Min,Max,false,colors,mesh);
+    draw();
+    return;
+  }
+  
+  if(mesh.indices.empty()) return;
+  
+  drawBuffer(&mesh.buffer[0],&mesh.indices[0],mesh.indices.size(),colors);
+}
+
 #endif
 
 } //namespace camp
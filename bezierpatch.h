@@ -12,28 +12,44 @@
 
 namespace camp {
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 
 extern int sign;
 
 extern const double Fuzz;
 extern const double Fuzz2;
 
+// The tessellation of a single surface, kept between frames so that a change
+// of view that leaves the required resolution bucket unchanged does not
+// subdivide the surface again.
+struct BezierMesh
+{
+  mem::vector<GLfloat> buffer;
+  mem::vector<GLuint> indices;
+  int bucket;
+  bool valid;
+  
+  BezierMesh() : valid(false) {}
+};
+
 struct BezierPatch
 {
-  static std::vector<GLfloat> buffer;
-  static std::vector<GLfloat> Buffer;
-  static std::vector<GLuint> indices;
-  static std::vector<GLuint> Indices;
-  static std::vector<GLfloat> tbuffer;
-  static std::vector<GLuint> tindices;
-  static std::vector<GLfloat> tBuffer;
-  static std::vector<GLuint> tIndices;
-  static GLuint nvertices;
-  static GLuint ntvertices;
-  static GLuint Nvertices;
-  static GLuint Ntvertices;
+  // Each thread tessellates into its own buffers.
+  static thread_local std::vector<GLfloat> buffer;
+  static thread_local std::vector<GLfloat> Buffer;
+  static thread_local std::vector<GLuint> indices;
+  static thread_local std::vector<GLuint> Indices;
+  static thread_local std::vector<GLfloat> tbuffer;
+  static thread_local std::vector<GLuint> tindices;
+  static thread_local std::vector<GLfloat> tBuffer;
+  static thread_local std::vector<GLuint> tIndices;
+  static thread_local GLuint nvertices;
+  static thread_local GLuint ntvertices;
+  static thread_local GLuint Nvertices;
+  static thread_local GLuint Ntvertices;
   std::vector<GLuint> *pindices;
+  std::vector<GLfloat> *pbuffer;
+  GLuint *pnvertices;
   triple u,v,w;
   double epsilon;
   double Epsilon;
@@ -219,6 +235,22 @@ struct BezierPatch
     render(g,straight,colors);
   }
   
+// Resolution buckets are a quarter of an octave wide; a surface is
+// tessellated at the finest resolution in its bucket.
+  static int bucket(double res) {
+    return (int) floor(4.0*log2(res));
+  }
+  
+  bool cached(double ratio, const BezierMesh& mesh) {
+    return mesh.valid && mesh.bucket == bucket(pixel*ratio);
+  }
+  
+// Queue g, which must lie entirely within Min and Max, reusing its
+// tessellation in mesh if the resolution bucket has not changed.
+  void queue(const triple *g, bool straight, double ratio,
+             const triple& Min, const triple& Max, bool transparent,
+             GLfloat *colors, BezierMesh& mesh);
+  
   void draw();
   void draw(const triple *g, bool straight, double ratio,
             const triple& Min, const triple& Max, bool transparent,
@@ -226,6 +258,11 @@ struct BezierPatch
     queue(g,straight,ratio,Min,Max,transparent,colors);
     draw();
   }
+  
+// Draw an opaque surface directly from its cached tessellation when possible.
+  void draw(const triple *g, bool straight, double ratio,
+            const triple& Min, const triple& Max, GLfloat *colors,
+            BezierMesh& mesh);
 };
 
 struct BezierTriangle : public BezierPatch {
@@ -305,6 +305,20 @@ void addVariable(venv &ve, T *ref, ty *t, symbol name,
   ve.enter(name, ent);
 }
 
+pen *currentPen() {
+  return &processData().currentpen;
+}
+
+// Variables that refer to data of the current process, found when the code
+// is run.
+template<class T, T *(*ref)()>
+void addVariable(venv &ve, ty *t, symbol name,
+                 record *module=settings::getSettingsModule()) {
+  access *a = new callRefAccess<T,ref>;
+  varEntry *ent = new varEntry(t, a, PUBLIC, module, 0, position());
+  ve.enter(name, ent);
+}
+
 template<class T>
 void addVariable(venv &ve, T value, ty *t, symbol name,
                  record *module=settings::getSettingsModule(),
@@ -881,7 +895,7 @@ void base_venv(venv &ve)
   addConstant<double>(ve, PI, primReal(), SYM(pi));
   addConstant<string>(ve, string(REVISION),primString(),SYM(VERSION));
 
-  addVariable<pen>(ve, &processData().currentpen, primPen(), SYM(currentpen));
+  addVariable<pen,currentPen>(ve, primPen(), SYM(currentpen));
 
 #ifdef OPENFUNCEXAMPLE
   addOpenFunc(ve, openFunc, primInt(), SYM(openFunc));
@@ -117,6 +117,67 @@ inline void reportEof(camp::file *f, Int count)
   }
 }
 
+// Read an nx x ny x nz array of integers or reals in bulk from the memory
+// map of an XDR/binary file, where ny and nz are -1 for lower dimensional
+// arrays and nx=0 reads to the end of the file. Return false to fall back to
+// reading one value at a time, which also reports a premature EOF.
+template<class T>
+bool readMappedArray(camp::file *f, vm::array *c, Int nx, Int ny, Int nz)
+{
+  if(nx < 0 || ny == 0 || nz == 0 || f->LineMode()) return false;
+  Int count=f->mappedCount(T());
+  if(count < 0) return false;
+  Int m=(ny > 0 ? ny : 1)*(nz > 0 ? nz : 1);
+  bool all=(nx == 0);
+  if(all) {
+    if(count % m) return false;
+    nx=count/m;
+  } else if(count < nx*m) return false;
+  
+  if(ny < 0) f->readMapped(c,nx,T());
+  else {
+    for(Int i=0; i < nx; i++) {
+      vm::array *ci=new vm::array(0);
+      c->push(ci);
+      if(nz < 0) f->readMapped(ci,ny,T());
+      else {
+        for(Int j=0; j < ny; j++) {
+          vm::array *cij=new vm::array(0);
+          ci->push(cij);
+          f->readMapped(cij,nz,T());
+        }
+      }
+    }
+  }
+  
+  // Leave the file in the same state as an element-wise read to EOF.
+  if(all) {
+    T v;
+    f->read(v);
+  }
+  return true;
+}
+
+template<class T>
+inline bool readMapped(camp::file *, vm::array *, Int, Int, Int)
+{
+  return false;
+}
+
+template<>
+inline bool readMapped<Int>(camp::file *f, vm::array *c, Int nx, Int ny,
+                            Int nz)
+{
+  return readMappedArray<Int>(f,c,nx,ny,nz);
+}
+
+template<>
+inline bool readMapped<double>(camp::file *f, vm::array *c, Int nx, Int ny,
+                               Int nz)
+{
+  return readMappedArray<double>(f,c,nx,ny,nz);
+}
+
 template<class T>
 void readArray(vm::stack *s, Int nx=-1, Int ny=-1, Int nz=-1)
 {
@@ -129,6 +190,10 @@ void readArray(vm::stack *s, Int nx=-1, Int ny=-1, Int nz=-1)
     if(ny == -2) {f->read(ny); f->Ny(-1); if(ny == 0) {s->push(c); return;}}
     if(nz != -1 && f->Nz() != -1) nz=f->Nz();
     if(nz == -2) {f->read(nz); f->Nz(-1); if(nz == 0) {s->push(c); return;}}
+    if(f->Mapped() && readMapped<T>(f,c,nx,ny,nz)) {
+      s->push(c);
+      return;
+    }
     T v;
     if(nx >= 0) {
       for(Int i=0; i < Limit(nx); i++) {
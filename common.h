@@ -28,6 +28,11 @@
 #define HAVE_GL
 #endif
 
+// The 3D renderer is built even without OpenGL, for the software rasterizer.
+#ifndef FOR_SHARED
+#define HAVE_RENDER
+#endif
+
 #ifdef HAVE_PTHREAD
 #include <pthread.h>
 #endif
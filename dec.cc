@@ -10,6 +10,7 @@
 #include "errormsg.h"
 #include "coenv.h"
 #include "dec.h"
+#include "modulecache.h"
 #include "fundec.h"
 #include "newexp.h"
 #include "stm.h"
@@ -823,6 +824,7 @@ void includedec::transAsField(coenv &e, record *r)
 {
   file *ast = parser::parseFile(filename,"Including");
   em.sync();
+  trans::modulecache::source(filename);
 
   // The runnables will be translated, one at a time, without any additional
   // scoping.
@@ -170,6 +170,9 @@ public:
 
   virtual bool is3D() {return false;}
 
+  // Is element a billboard, which is rotated to face the camera?
+  virtual bool billboard() {return false;}
+
 // Implement element as raw SVG code?
   virtual bool svg() {return false;}
   
@@ -213,6 +216,13 @@ public:
                       const triple& Min, const triple& Max,
                       double perspective, bool lighton, bool transparent) {}
 
+  // Tessellate for rendering in the view with inverse modelview matrix T,
+  // without calling OpenGL. Distinct elements may be tessellated
+  // concurrently.
+  virtual void tessellate(const double *T, double size2,
+                          const triple& Min, const triple& Max,
+                          double perspective) {}
+
   // Transform as part of a picture.
   virtual drawElement *transformed(const transform&) {
     return this;
@@ -11,6 +11,7 @@
 #include "settings.h"
 #include "util.h"
 #include "lexical.h"
+#include "labelcache.h"
 
 using namespace settings;
 
@@ -64,6 +65,23 @@ void texbounds(double& width, double& height, double& depth,
   texdim(tex,depth,"dp","depth");
 }   
 
+// Reads a dimension of the form <value>pt terminated by stop from buffer,
+// starting at pos.
+bool texdim(const string& buffer, size_t& pos, double& dest, char stop)
+{
+  size_t end=buffer.find(stop,pos);
+  if(end == string::npos || end < pos+2 || buffer.compare(end-2,2,"pt") != 0)
+    return false;
+  string n=buffer.substr(pos,end-2-pos);
+  pos=end+1;
+  try {
+    dest=lexical::cast<double>(n,true)*tex2ps;
+  } catch(lexical::bad_cast&) {
+    return false;
+  }
+  return true;
+}
+
 inline double urand()
 {                         
   static const double factor=2.0/RANDOM_MAX;
@@ -86,16 +104,134 @@ void setpen(iopipestream& tex, const string& texengine, const pen& pentype)
   drawElement::lastpen=pentype;
 }
 
+namespace {
+const string start(">dim(");
+const string stop(")dim");
+const string expect(">end"+stop+"\n\n*");
+}
+
+void drawLabel::lookup(mem::vector<drawLabel *>& labels)
+{
+  size_t k=0;
+  for(size_t i=0; i < labels.size(); ++i) {
+    drawLabel *L=labels[i];
+    if(L->havebounds || L->havemetrics) continue;
+    if(labelcache::lookup(L->pentype,L->label,L->size,L->width,L->height,
+                          L->depth))
+      L->havemetrics=true;
+    else
+      labels[k++]=L;
+  }
+  labels.resize(k);
+}
+
+size_t drawLabel::texbatch(texpipe& pipe, mem::vector<drawLabel *>& labels,
+                           size_t i, size_t n, bool Latex)
+{
+  // Limit the TeX input sent per round trip so that neither pipe can fill.
+  static const std::streamoff maxbatch=8192;
+  
+  ostringstream buf;
+  for(; i < n && buf.tellp() < maxbatch; ++i) {
+    drawLabel *L=labels[i];
+    if(Latex && setlatexfont(buf,L->pentype,*pipe.lastpen))
+      buf << "\n";
+    if(settexfont(buf,L->pentype,*pipe.lastpen,Latex))
+      buf << "\n";
+    *pipe.lastpen=L->pentype;
+    buf << "\\setbox\\ASYbox=\\hbox{" << stripblanklines(L->label)
+        << "}\n\n"
+        << "\\immediate\\write16{" << start << i
+        << ",\\the\\wd\\ASYbox,\\the\\ht\\ASYbox,\\the\\dp\\ASYbox"
+        << stop << "}\n";
+  }
+  buf << "\\immediate\\write16{>end" << stop << "}\n";
+  *pipe.tex << buf.str();
+  return i;
+}
+
+void drawLabel::texparse(texpipe& pipe, mem::vector<drawLabel *>& labels,
+                         size_t first, size_t last)
+{
+  pipe.tex->wait(expect.c_str());
+  string buffer=pipe.tex->getbuffer();
+    
+  size_t pos=0;
+  for(size_t j=first; j < last; ++j) {
+    drawLabel *L=labels[j];
+    ostringstream buf;
+    buf << start << j << ",";
+    const string& index=buf.str();
+    pos=buffer.find(index,pos);
+    if(pos != string::npos) pos += index.size();
+    if(pos == string::npos ||
+       !texdim(buffer,pos,L->width,',') ||
+       !texdim(buffer,pos,L->height,',') ||
+       !texdim(buffer,pos,L->depth,')'))
+      camp::reportError("Cannot read label \""+L->label+"\"");
+  }
+}
+
+void drawLabel::getbounds(mem::vector<drawLabel *>& labels, texpipes& pipes,
+                          const string& texengine)
+{
+  bool Latex=latex(texengine);
+  size_t n=labels.size();
+  size_t npipes=pipes.size();
+  
+  // Assign a contiguous block of labels to each pipe; the metrics do not
+  // depend on which pipe measured them.
+  mem::vector<size_t> first(npipes), next(npipes), last(npipes);
+  for(size_t k=0; k < npipes; ++k) {
+    next[k]=k*n/npipes;
+    last[k]=(k+1)*n/npipes;
+  }
+  
+  for(;;) {
+    bool active=false;
+    for(size_t k=0; k < npipes; ++k) {
+      first[k]=next[k];
+      if(next[k] < last[k]) {
+        next[k]=texbatch(pipes[k],labels,next[k],last[k],Latex);
+        active=true;
+      }
+    }
+    if(!active) break;
+    for(size_t k=0; k < npipes; ++k) {
+      if(first[k] < next[k])
+        texparse(pipes[k],labels,first[k],next[k]);
+    }
+  }
+    
+  for(size_t j=0; j < n; ++j) {
+    drawLabel *L=labels[j];
+    if(L->width == 0.0 && L->height == 0.0 && L->depth == 0.0 &&
+       !L->size.empty()) {
+      setpen(*pipes[0].tex,texengine,L->pentype);
+      texbounds(L->width,L->height,L->depth,*pipes[0].tex,L->size);
+    }
+    L->havemetrics=true;
+    labelcache::store(L->pentype,L->label,L->size,L->width,L->height,
+                      L->depth);
+  }
+}
+
 void drawLabel::getbounds(iopipestream& tex, const string& texengine)
 {
   if(havebounds) return;
   havebounds=true;
   
-  setpen(tex,texengine,pentype);
-  texbounds(width,height,depth,tex,label);
+  if(!havemetrics &&
+     !labelcache::lookup(pentype,label,size,width,height,depth)) {
+    setpen(tex,texengine,pentype);
+    texbounds(width,height,depth,tex,label);
   
-  if(width == 0.0 && height == 0.0 && depth == 0.0 && !size.empty())
-    texbounds(width,height,depth,tex,size);
+    if(width == 0.0 && height == 0.0 && depth == 0.0 && !size.empty())
+      texbounds(width,height,depth,tex,size);
+    
+    labelcache::store(pentype,label,size,width,height,depth);
+  }
+  havemetrics=true;
 
   enabled=true;
     
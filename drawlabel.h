@@ -15,6 +15,15 @@
 
 namespace camp {
   
+// A TeX pipe together with the pen to which its font was last set.
+struct texpipe {
+  iopipestream *tex;
+  pen *lastpen;
+  texpipe(iopipestream *tex, pen *lastpen) : tex(tex), lastpen(lastpen) {}
+};
+
+typedef mem::vector<texpipe> texpipes;
+  
 class drawLabel : public virtual drawElement {
 protected:
   string label,size;
@@ -25,6 +34,7 @@ protected:
   pen pentype;
   double width,height,depth;
   bool havebounds;
+  bool havemetrics;
   bool suppress;
   pair Align;
   pair texAlign;
@@ -36,13 +46,21 @@ public:
             pair align, pen pentype, const string& key="")
     : drawElement(key), label(label), size(size), T(shiftless(T)),
       position(position), align(align), pentype(pentype), width(0.0),
-      height(0.0), depth(0.0), havebounds(false), suppress(false),
-      enabled(false) {} 
+      height(0.0), depth(0.0), havebounds(false), havemetrics(false),
+      suppress(false), enabled(false) {} 
   
   virtual ~drawLabel() {}
 
   void getbounds(iopipestream& tex, const string& texengine);
   
+  // Retain only those labels whose metrics are neither known nor cached.
+  static void lookup(mem::vector<drawLabel *>& labels);
+  
+  // Obtain the metrics of labels with one TeX query per batch, distributing
+  // the labels over the given pipes.
+  static void getbounds(mem::vector<drawLabel *>& labels, texpipes& pipes,
+                        const string& texengine);
+  
   void checkbounds();
     
   void bounds(bbox& b, iopipestream&, boxvector&, bboxlist&);
@@ -56,6 +74,16 @@ public:
   drawElement *transformed(const transform& t);
   
   void labelwarning(const char *action); 
+  
+private:
+  // Send the labels from i to n (up to a batch limit) to the pipe,
+  // returning the index of the first label not sent.
+  static size_t texbatch(texpipe& pipe, mem::vector<drawLabel *>& labels,
+                         size_t i, size_t n, bool Latex);
+  
+  // Read the metrics of the labels from first to last from the pipe.
+  static void texparse(texpipe& pipe, mem::vector<drawLabel *>& labels,
+                       size_t first, size_t last);
 };
 
 class drawLabelPath : public drawLabel, public drawPathPenBase {
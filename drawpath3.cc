@@ -47,13 +47,13 @@ void drawPath3::render(GLUnurbs *nurb, double size2,
                        const triple& b, const triple& B,
                        double perspective, bool lighton, bool transparent)
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   Int n=g.length();
   if(n == 0 || invisible || ((color.A < 1.0) ^ transparent))
     return;
 
   const bool billboard=interaction == BILLBOARD &&
-    !settings::getSetting<bool>("offscreen");
+    !settings::getSetting<bool>("offscreen") && !software;
   triple m,M;
   
   double f,F,s;
@@ -72,7 +72,7 @@ void drawPath3::render(GLUnurbs *nurb, double size2,
   const pair size3(s*(B.getx()-b.getx()),s*(B.gety()-b.gety()));
   
   double t[16]; // current transform
-  glGetDoublev(GL_MODELVIEW_MATRIX,t);
+  getModelview(t);
 // Like Fortran, OpenGL uses transposed (column-major) format!
   run::transpose(t,4);
   run::inverse(t,4);
@@ -89,14 +89,14 @@ void drawPath3::render(GLUnurbs *nurb, double size2,
   drawBezierPatch::S.draw();
   
   GLfloat Diffuse[]={0.0,0.0,0.0,(GLfloat) color.A};
-  glMaterialfv(GL_FRONT,GL_DIFFUSE,Diffuse);
+  setMaterial(GL_FRONT,GL_DIFFUSE,Diffuse);
   static GLfloat Black[]={0.0,0.0,0.0,1.0};
-  glMaterialfv(GL_FRONT,GL_AMBIENT,Black);
+  setMaterial(GL_FRONT,GL_AMBIENT,Black);
   GLfloat Emissive[]={(GLfloat) color.R,(GLfloat) color.G,(GLfloat) color.B,
 		      (GLfloat) color.A};
-  glMaterialfv(GL_FRONT,GL_EMISSION,Emissive);
-  glMaterialfv(GL_FRONT,GL_SPECULAR,Black);
-  glMaterialf(GL_FRONT,GL_SHININESS,128.0);
+  setMaterial(GL_FRONT,GL_EMISSION,Emissive);
+  setMaterial(GL_FRONT,GL_SPECULAR,Black);
+  setShininess(GL_FRONT,128.0);
   
   
   
@@ -196,7 +196,7 @@ void drawNurbsPath3::ratio(const double* t, pair &b, double (*m)(double, double)
 
 void drawNurbsPath3::displacement()
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   size_t nknots=degree+n+1;
   if(Controls == NULL) {
     Controls=new(UseGC)  GLfloat[(weights ? 4 : 3)*n];
@@ -219,7 +219,7 @@ void drawNurbsPath3::render(GLUnurbs *nurb, double, const triple&,
                             bool transparent)
 {
 #ifdef HAVE_GL
-  if(invisible || ((color.A < 1.0) ^ transparent))
+  if(invisible || ((color.A < 1.0) ^ transparent) || software)
     return;
   
   GLfloat Diffuse[]={0.0,0.0,0.0,(GLfloat) color.A};
@@ -15,7 +15,7 @@ namespace camp {
 
 class drawPath3 : public drawElement {
 protected:
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   BezierCurve R;
 #endif  
   const path3 g;
@@ -43,6 +43,8 @@ public:
 
   bool is3D() {return true;}
   
+  bool billboard() {return interaction == BILLBOARD;}
+  
   void bounds(const double* t, bbox3& B) {
     if(t != NULL) {
       const path3 tg(camp::transformed(t,g));
@@ -87,7 +89,7 @@ protected:
   bool invisible;
   triple Min,Max;
   
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   GLfloat *Controls;
   GLfloat *Knots;
 #endif  
@@ -126,7 +128,7 @@ public:
     
     run::copyArrayC(knots,knot,0,NoGC);
     
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
     Controls=NULL;
 #endif  
   }
@@ -138,7 +140,7 @@ public:
     for(unsigned int i=0; i < n; ++i)
       controls[i]=t*s->controls[i];
     
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
     Controls=NULL;
 #endif    
   }
@@ -23,7 +23,7 @@ double Tz[3]; // z-component of current transform
 
 using vm::array;
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 BezierCurve drawSurface::C;
 BezierPatch drawBezierPatch::S;
 BezierTriangle drawBezierTriangle::S;
@@ -46,6 +46,22 @@ void storecolor(GLfloat *colors, int i, const RGBAColour& p)
   colors[i+3]=p.A;
 }
 
+void setMaterial(GLenum face, GLenum pname, const GLfloat *params)
+{
+  if(software) software->material(pname,params);
+#ifdef HAVE_GL
+  else glMaterialfv(face,pname,params);
+#endif
+}
+
+void setShininess(GLenum face, GLfloat shininess)
+{
+  if(software) software->materialShininess(shininess);
+#ifdef HAVE_GL
+  else glMaterialf(face,GL_SHININESS,shininess);
+#endif
+}
+
 void setcolors(bool colors, bool lighton,
                const RGBAColour& diffuse,
                const RGBAColour& ambient,
@@ -76,34 +92,63 @@ void setcolors(bool colors, bool lighton,
   }
 
   if(colors) {
-    if(!lighton) 
-      glColorMaterial(GL_FRONT_AND_BACK,GL_EMISSION);
+    if(!lighton) {
+      if(software) software->colorMaterial(GL_EMISSION);
+#ifdef HAVE_GL
+      else glColorMaterial(GL_FRONT_AND_BACK,GL_EMISSION);
+#endif
+    }
 
     GLfloat Black[]={0,0,0,(GLfloat) diffuse.A};
-    glMaterialfv(GL_FRONT_AND_BACK,GL_DIFFUSE,Black);
-    glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT,Black);
-    glMaterialfv(GL_FRONT_AND_BACK,GL_EMISSION,Black);
+    setMaterial(GL_FRONT_AND_BACK,GL_DIFFUSE,Black);
+    setMaterial(GL_FRONT_AND_BACK,GL_AMBIENT,Black);
+    setMaterial(GL_FRONT_AND_BACK,GL_EMISSION,Black);
   } else {
     GLfloat Diffuse[]={(GLfloat) diffuse.R,(GLfloat) diffuse.G,
 		       (GLfloat) diffuse.B,(GLfloat) diffuse.A};
-    glMaterialfv(GL_FRONT_AND_BACK,GL_DIFFUSE,Diffuse);
+    setMaterial(GL_FRONT_AND_BACK,GL_DIFFUSE,Diffuse);
   
     GLfloat Ambient[]={(GLfloat) ambient.R,(GLfloat) ambient.G,
 		       (GLfloat) ambient.B,(GLfloat) ambient.A};
-    glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT,Ambient);
+    setMaterial(GL_FRONT_AND_BACK,GL_AMBIENT,Ambient);
   
     GLfloat Emissive[]={(GLfloat) emissive.R,(GLfloat) emissive.G,
 			(GLfloat) emissive.B,(GLfloat) emissive.A};
-    glMaterialfv(GL_FRONT_AND_BACK,GL_EMISSION,Emissive);
+    setMaterial(GL_FRONT_AND_BACK,GL_EMISSION,Emissive);
   }
     
   if(lighton) {
     GLfloat Specular[]={(GLfloat) specular.R,(GLfloat) specular.G,
 			(GLfloat) specular.B,(GLfloat) specular.A};
-    glMaterialfv(GL_FRONT_AND_BACK,GL_SPECULAR,Specular);
+    setMaterial(GL_FRONT_AND_BACK,GL_SPECULAR,Specular);
   
-    glMaterialf(GL_FRONT_AND_BACK,GL_SHININESS,128.0*shininess);
+    setShininess(GL_FRONT_AND_BACK,128.0*shininess);
+  }
+}
+
+void drawSurface::viewport(const double *T, const triple& b, const triple& B,
+                           double perspective, triple& m, triple& M,
+                           pair& size3)
+{
+  double f,F,s;
+  if(perspective) {
+    f=Min.getz()*perspective;
+    F=Max.getz()*perspective;
+    m=triple(min(f*b.getx(),F*b.getx()),min(f*b.gety(),F*b.gety()),b.getz());
+    M=triple(max(f*B.getx(),F*B.getx()),max(f*B.gety(),F*B.gety()),B.getz());
+    s=max(f,F);
+  } else {
+    m=b;
+    M=B;
+    s=1.0;
   }
+  
+  size3=pair(s*(B.getx()-b.getx()),s*(B.gety()-b.gety()));
+  
+  bbox3 box(m,M);
+  box.transform(T);
+  m=box.Min();
+  M=box.Max();
 }
 
 #endif  
@@ -252,32 +297,16 @@ void drawBezierPatch::render(GLUnurbs *nurb, double size2,
                              double perspective, bool lighton,
                              bool transparent)
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   if(invisible || 
      ((colors ? colors[0].A+colors[1].A+colors[2].A+colors[3].A < 4.0 :
        diffuse.A < 1.0) ^ transparent)) return;
   
   const bool billboard=interaction == BILLBOARD &&
-    !settings::getSetting<bool>("offscreen");
-  triple m,M;
-  
-  double f,F,s;
-  if(perspective) {
-    f=Min.getz()*perspective;
-    F=Max.getz()*perspective;
-    m=triple(min(f*b.getx(),F*b.getx()),min(f*b.gety(),F*b.gety()),b.getz());
-    M=triple(max(f*B.getx(),F*B.getx()),max(f*B.gety(),F*B.gety()),B.getz());
-    s=max(f,F);
-  } else {
-    m=b;
-    M=B;
-    s=1.0;
-  }
-  
-  const pair size3(s*(B.getx()-b.getx()),s*(B.gety()-b.gety()));
+    !settings::getSetting<bool>("offscreen") && !software;
   
   double t[16]; // current transform
-  glGetDoublev(GL_MODELVIEW_MATRIX,t);
+  getModelview(t);
 // Like Fortran, OpenGL uses transposed (column-major) format!
   run::transpose(t,4);
 /*  
@@ -295,14 +324,11 @@ void drawBezierPatch::render(GLUnurbs *nurb, double size2,
   Tz[2]=t[10];
   
   run::inverse(t,4);
-  bbox3 box(m,M);
-  box.transform(t);
-  m=box.Min();
-  M=box.Max();
+  triple m,M;
+  pair size3;
+  viewport(t,b,B,perspective,m,M,size3);
   
-  if(!billboard && (Max.getx() < m.getx() || Min.getx() > M.getx() ||
-                    Max.gety() < m.gety() || Min.gety() > M.gety() ||
-                    Max.getz() < m.getz() || Min.getz() > M.getz()))
+  if(!billboard && offscreen(m,M))
     return;
 
   setcolors(colors,lighton,diffuse,ambient,emissive,specular,shininess);
@@ -334,14 +360,48 @@ void drawBezierPatch::render(GLUnurbs *nurb, double size2,
     C.queue(edge3,straight,size3.length()/size2,m,M);
     C.draw();
   } else {
-    S.queue(Controls,straight,size3.length()/size2,m,M,transparent,
-            colors ? v : NULL);
-    if(!transparent) 
-      S.draw();
+    double ratio=size3.length()/size2;
+    if(!billboard && cacheable(m,M)) {
+      if(transparent)
+        S.queue(Controls,straight,ratio,m,M,true,colors ? v : NULL,mesh);
+      else
+        S.draw(Controls,straight,ratio,m,M,colors ? v : NULL,mesh);
+    } else {
+      S.queue(Controls,straight,ratio,m,M,transparent,colors ? v : NULL);
+      if(!transparent) 
+        S.draw();
+    }
   }
 #endif
 }
 
+void drawBezierPatch::tessellate(const double *T, double size2,
+                                 const triple& b, const triple& B,
+                                 double perspective)
+{
+#ifdef HAVE_RENDER
+  if(invisible || interaction == BILLBOARD || gl::outlinemode) return;
+  
+  bool transparent=colors ? colors[0].A+colors[1].A+colors[2].A+colors[3].A < 4.0 :
+    diffuse.A < 1.0;
+  
+  triple m,M;
+  pair size3;
+  viewport(T,b,B,perspective,m,M,size3);
+  double ratio=size3.length()/size2;
+  if(offscreen(m,M) || !cacheable(m,M) || S.cached(ratio,mesh)) return;
+  
+  GLfloat v[16];
+  if(colors)
+    for(size_t i=0; i < 4; ++i)
+      storecolor(v,4*i,colors[i]);
+  
+  BezierPatch P;
+  P.queue(controls,straight,ratio,m,M,transparent,colors ? v : NULL,mesh);
+  P.clear();
+#endif
+}
+
 drawElement *drawBezierPatch::transformed(const double* t)
 {
   return new drawBezierPatch(t,this);
@@ -490,32 +550,16 @@ void drawBezierTriangle::render(GLUnurbs *nurb, double size2,
                                 double perspective, bool lighton,
                                 bool transparent)
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   if(invisible || 
      ((colors ? colors[0].A+colors[1].A+colors[2].A < 3.0 :
        diffuse.A < 1.0) ^ transparent)) return;
   
   const bool billboard=interaction == BILLBOARD &&
-    !settings::getSetting<bool>("offscreen");
-  triple m,M;
-  
-  double f,F,s;
-  if(perspective) {
-    f=Min.getz()*perspective;
-    F=Max.getz()*perspective;
-    m=triple(min(f*b.getx(),F*b.getx()),min(f*b.gety(),F*b.gety()),b.getz());
-    M=triple(max(f*B.getx(),F*B.getx()),max(f*B.gety(),F*B.gety()),B.getz());
-    s=max(f,F);
-  } else {
-    m=b;
-    M=B;
-    s=1.0;
-  }
-  
-  const pair size3(s*(B.getx()-b.getx()),s*(B.gety()-b.gety()));
+    !settings::getSetting<bool>("offscreen") && !software;
   
   double t[16]; // current transform
-  glGetDoublev(GL_MODELVIEW_MATRIX,t);
+  getModelview(t);
 // Like Fortran, OpenGL uses transposed (column-major) format!
   run::transpose(t,4);
 /*  
@@ -533,14 +577,11 @@ void drawBezierTriangle::render(GLUnurbs *nurb, double size2,
   Tz[2]=t[10];
 
   run::inverse(t,4);
-  bbox3 box(m,M);
-  box.transform(t);
-  m=box.Min();
-  M=box.Max();
-
-  if(!billboard && (Max.getx() < m.getx() || Min.getx() > M.getx() ||
-                    Max.gety() < m.gety() || Min.gety() > M.gety() ||
-                    Max.getz() < m.getz() || Min.getz() > M.getz()))
+  triple m,M;
+  pair size3;
+  viewport(t,b,B,perspective,m,M,size3);
+  
+  if(!billboard && offscreen(m,M))
     return;
 
   setcolors(colors,lighton,diffuse,ambient,emissive,specular,shininess);
@@ -570,14 +611,48 @@ void drawBezierTriangle::render(GLUnurbs *nurb, double size2,
     C.queue(edge2,straight,size3.length()/size2,m,M);
     C.draw();
   } else {
-    S.queue(Controls,straight,size3.length()/size2,m,M,transparent,
-            colors ? v : NULL);
-    if(!transparent) 
-      S.draw();
+    double ratio=size3.length()/size2;
+    if(!billboard && cacheable(m,M)) {
+      if(transparent)
+        S.queue(Controls,straight,ratio,m,M,true,colors ? v : NULL,mesh);
+      else
+        S.draw(Controls,straight,ratio,m,M,colors ? v : NULL,mesh);
+    } else {
+      S.queue(Controls,straight,ratio,m,M,transparent,colors ? v : NULL);
+      if(!transparent) 
+        S.draw();
+    }
   }
 #endif
 }
 
+void drawBezierTriangle::tessellate(const double *T, double size2,
+                                    const triple& b, const triple& B,
+                                    double perspective)
+{
+#ifdef HAVE_RENDER
+  if(invisible || interaction == BILLBOARD || gl::outlinemode) return;
+  
+  bool transparent=colors ? colors[0].A+colors[1].A+colors[2].A < 3.0 :
+    diffuse.A < 1.0;
+  
+  triple m,M;
+  pair size3;
+  viewport(T,b,B,perspective,m,M,size3);
+  double ratio=size3.length()/size2;
+  if(offscreen(m,M) || !cacheable(m,M) || S.cached(ratio,mesh)) return;
+  
+  GLfloat v[12];
+  if(colors)
+    for(size_t i=0; i < 3; ++i)
+      storecolor(v,4*i,colors[i]);
+  
+  BezierTriangle P;
+  P.queue(controls,straight,ratio,m,M,transparent,colors ? v : NULL,mesh);
+  P.clear();
+#endif
+}
+
 drawElement *drawBezierTriangle::transformed(const double* t)
 {
   return new drawBezierTriangle(t,this);
@@ -660,7 +735,7 @@ void drawNurbs::ratio(const double *t, pair &b, double (*m)(double, double),
 
 void drawNurbs::displacement()
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   size_t n=nu*nv;
   size_t nuknots=udegree+nu+1;
   size_t nvknots=vdegree+nv+1;
@@ -693,8 +768,11 @@ void drawNurbs::render(GLUnurbs *nurb, double size2,
   if(invisible || ((colors ? colors[3]+colors[7]+colors[11]+colors[15] < 4.0
                     : diffuse.A < 1.0) ^ transparent)) return;
   
+  // The software rasterizer has no NURBS tessellator.
+  if(software) return;
+  
   double t[16]; // current transform
-  glGetDoublev(GL_MODELVIEW_MATRIX,t);
+  getModelview(t);
   run::transpose(t,4);
 
   bbox3 B(this->Min,this->Max);
@@ -912,16 +990,35 @@ void drawPixel::render(GLUnurbs *nurb, double size2,
                        const triple& Min, const triple& Max,
                        double perspective, bool lighton, bool transparent) 
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   if(invisible)
     return;
   
   GLfloat V[4];
 
+  static GLfloat Black[]={0,0,0,1};
+  
+  if(software) {
+    software->enableColorMaterial(true);
+    software->colorMaterial(GL_EMISSION);
+    software->material(GL_DIFFUSE,Black);
+    software->material(GL_AMBIENT,Black);
+    software->material(GL_SPECULAR,Black);
+    software->materialShininess(0.0);
+    software->setPointSize(1.0+width);
+    GLfloat C[4];
+    storecolor(C,0,c);
+    store(V,v);
+    software->point(V,C);
+    software->setPointSize(1.0);
+    software->enableColorMaterial(false);
+    return;
+  }
+  
+#ifdef HAVE_GL
   glEnable(GL_COLOR_MATERIAL);
   glColorMaterial(GL_FRONT_AND_BACK,GL_EMISSION);
   
-  static GLfloat Black[]={0,0,0,1};
   glMaterialfv(GL_FRONT_AND_BACK,GL_DIFFUSE,Black);
   glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT,Black);
   glMaterialfv(GL_FRONT_AND_BACK,GL_SPECULAR,Black);
@@ -939,6 +1036,7 @@ void drawPixel::render(GLUnurbs *nurb, double size2,
   glPointSize(1.0);
   glDisable(GL_COLOR_MATERIAL);
 #endif
+#endif
 }
 
 const string drawBaseTriangles::wrongsize=
@@ -1010,7 +1108,7 @@ void drawTriangles::render(GLUnurbs *nurb, double size2, const triple& Min,
                            const triple& Max, double perspective, bool lighton,
                            bool transparent)
 {
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   if(invisible)
     return;
 
@@ -1018,7 +1116,7 @@ void drawTriangles::render(GLUnurbs *nurb, double size2, const triple& Min,
 
   triple m,M;
   double t[16]; // current transform
-  glGetDoublev(GL_MODELVIEW_MATRIX,t);
+  getModelview(t);
   run::transpose(t,4);
 
   bbox3 B(this->Min,this->Max);
@@ -1047,6 +1145,26 @@ void drawTriangles::render(GLUnurbs *nurb, double size2, const triple& Min,
   setcolors(nC,!nC,diffuse,ambient,emissive,specular,shininess);
   if(!nN) lighton=false;
   
+  if(software) {
+    software->enableColorMaterial(nC);
+    for(size_t i=0; i < nI; i++) {
+      const uint32_t *pi=PI[i];
+      const uint32_t *ni=NI[i];
+      const uint32_t *ci=nC ? CI[i] : 0;
+      for(size_t j=0; j < 3; ++j) {
+        if(lighton)
+          software->normal(N[ni[j]].getx(),N[ni[j]].gety(),N[ni[j]].getz());
+        if(nC)
+          software->color(C[ci[j]].R,C[ci[j]].G,C[ci[j]].B,C[ci[j]].A);
+        software->vertex(P[pi[j]].getx(),P[pi[j]].gety(),P[pi[j]].getz());
+      }
+    }
+    software->endTriangles();
+    software->enableColorMaterial(false);
+    return;
+  }
+  
+#ifdef HAVE_GL
   glBegin(GL_TRIANGLES);
   for(size_t i=0; i < nI; i++) {
     const uint32_t *pi=PI[i];
@@ -1073,6 +1191,7 @@ void drawTriangles::render(GLUnurbs *nurb, double size2, const triple& Min,
   if(nC)
     glDisable(GL_COLOR_MATERIAL);
 #endif
+#endif
 }
 
 } //namespace camp
@@ -12,11 +12,16 @@
 #include "path3.h"
 #include "beziercurve.h"
 #include "bezierpatch.h"
+#include "swrender.h"
 
 namespace camp {
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 void storecolor(GLfloat *colors, int i, const vm::array &pens, int j);
+
+// Set a material property of OpenGL or of the software rasterizer.
+void setMaterial(GLenum face, GLenum pname, const GLfloat *params);
+void setShininess(GLenum face, GLfloat shininess);
 #endif  
 
 class drawSurface : public drawElement {
@@ -39,8 +44,36 @@ protected:
   triple Min,Max;
   bool prc;
   
+#ifdef HAVE_RENDER
+  BezierMesh mesh;
+  
+  // Return true iff no part of the surface can be culled by the viewing
+  // volume m,M, so that its tessellation depends only on the resolution.
+  bool cacheable(const triple& m, const triple& M) {
+    double x,y,z;
+    double X,Y,Z;
+    boundstriples(x,y,z,X,Y,Z,ncontrols,controls);
+    return
+      m.getx() <= x && X <= M.getx() &&
+      m.gety() <= y && Y <= M.gety() &&
+      m.getz() <= z && Z <= M.getz();
+  }
+  
+  // Return in m,M the viewing volume b,B mapped through the inverse
+  // modelview matrix T and in size3 its size.
+  void viewport(const double *T, const triple& b, const triple& B,
+                double perspective, triple& m, triple& M, pair& size3);
+  
+  bool offscreen(const triple& m, const triple& M) {
+    return
+      Max.getx() < m.getx() || Min.getx() > M.getx() ||
+      Max.gety() < m.gety() || Min.gety() > M.gety() ||
+      Max.getz() < m.getz() || Min.getz() > M.getz();
+  }
+#endif
+  
 public:
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   static BezierCurve C;
 #endif  
   
@@ -101,7 +134,7 @@ public:
         controls[i]=t*s->controls[i];
     } else controls=NULL;
   
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
     center=t*s->center;
 #endif    
   }
@@ -109,11 +142,13 @@ public:
   virtual ~drawSurface() {}
 
   bool is3D() {return true;}
+  
+  bool billboard() {return interaction == BILLBOARD;}
 };
   
 class drawBezierPatch : public drawSurface {
 public:  
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   static BezierPatch S;
 #endif  
   
@@ -137,12 +172,14 @@ public:
   
   void render(GLUnurbs *nurb, double, const triple& Min, const triple& Max,
               double perspective, bool lighton, bool transparent);
+  void tessellate(const double *T, double size2, const triple& Min,
+                  const triple& Max, double perspective);
   drawElement *transformed(const double* t);
 };
   
 class drawBezierTriangle : public drawSurface {
 public:
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   static BezierTriangle S;
 #endif  
   
@@ -166,6 +203,8 @@ public:
   
   void render(GLUnurbs *nurb, double, const triple& Min, const triple& Max,
               double perspective, bool lighton, bool transparent);
+  void tessellate(const double *T, double size2, const triple& Min,
+                  const triple& Max, double perspective);
   drawElement *transformed(const double* t);
 };
   
@@ -188,7 +227,7 @@ protected:
   
   triple Min,Max;
   
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   GLfloat *colors;
   GLfloat *Controls;
   GLfloat *uKnots;
@@ -256,7 +295,7 @@ public:
     emissive=rgba(vm::read<camp::pen>(p,2));
     specular=rgba(vm::read<camp::pen>(p,3));
     
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
     Controls=NULL;
     int size=checkArray(&pens);
     if(size > 0) {
@@ -283,7 +322,7 @@ public:
     for(unsigned int i=0; i < n; ++i)
       controls[i]=t*s->controls[i];
     
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
     Controls=NULL;
     colors=s->colors;
 #endif    
@@ -9,6 +9,7 @@
 #define DRAWVERBATIM_H
 
 #include "drawelement.h"
+#include "labelcache.h"
 
 namespace camp {
 
@@ -35,8 +36,11 @@ public:
   void bounds(bbox& b, iopipestream& tex, boxvector&, bboxlist&) {
     if(havebounds) return;
     havebounds=true;
-    if(language == TeX) 
+    if(language == TeX) {
       tex << text << "%" << newl;
+      processData().TeXpipelog.push_back(text+"%\n");
+      labelcache::append(text);
+    }
     if(userbounds) {
       b += min;
       b += max;
@@ -5,8 +5,15 @@
  * Handle input/output
  ******/
 
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "fileio.h"
 #include "settings.h"
+#include "array.h"
 
 namespace camp {
 
@@ -41,6 +48,7 @@ void ifile::ignoreComment()
   
 bool ifile::eol()
 {
+  endTable();
   int c;
   while(isspace(c=stream->peek())) {
     if(c == '\n') return true;
@@ -54,6 +62,7 @@ bool ifile::eol()
   
 bool ifile::nexteol()
 {
+  endTable();
   int c;
   if(nullfield) {
     nullfield=false;
@@ -97,6 +106,30 @@ void ifile::csv()
   if(c == ',') comma=true;
 }
   
+vm::array *ifile::readTable(size_t n, bool ahead)
+{
+  if(binary) noread("real[][]");
+  if(table && table->csvMode() != csvmode) endTable();
+  if(!table)
+    table=new tablereader(name,stream,comment,csvmode,ahead);
+  return table->read(n);
+}
+
+// Reposition the stream at the first line not returned by the table reader,
+// which reads ahead in chunks. Rows buffered from standard input or another
+// stream that cannot seek are lost.
+void ifile::endTable()
+{
+  if(!table) return;
+  std::streamoff pos=table->tell();
+  delete table;
+  table=NULL;
+  if(pos >= 0) {
+    stream->clear();
+    stream->seekg(pos);
+  }
+}
+  
 void ifile::Read(string& val)
 {
   string s;
@@ -177,4 +210,120 @@ void ofile::writeline()
   if(errorstream::interrupt) {interact::lines=0; throw interrupted();}
 }
   
+bool memorymap::open(const string& filename)
+{
+  if(data) return true;
+  name=filename;
+  int fd=::open(name.c_str(),O_RDONLY);
+  if(fd < 0) return false;
+  struct stat buf;
+  if(fstat(fd,&buf) == 0 && buf.st_size > 0) {
+    void *p=mmap(NULL,buf.st_size,PROT_READ,MAP_SHARED,fd,0);
+    if(p != MAP_FAILED) {
+      data=(char *) p;
+      length=buf.st_size;
+#ifdef MADV_SEQUENTIAL
+      madvise(data,length,MADV_SEQUENTIAL);
+#endif      
+    }
+  }
+  ::close(fd);
+  return data != NULL;
+}
+
+void memorymap::close()
+{
+  if(data) {
+    munmap(data,length);
+    data=NULL;
+    length=0;
+  }
+}
+
+namespace {
+
+template<class U>
+inline U nativeValue(const char *p)
+{
+  U u;
+  memcpy(&u,p,sizeof(U));
+  return u;
+}
+
+// XDR values are big endian.
+template<class U>
+inline U xdrValue(const char *p)
+{
+  U u=0;
+  for(size_t i=0; i < sizeof(U); ++i)
+    u=(u << 8) | (unsigned char) p[i];
+  return u;
+}
+
+// Append n integers stored as S (or as its unsigned counterpart U) to a.
+template<class S, class U>
+void appendInts(vm::array *a, const char *p, size_t n, bool signedint,
+                bool xdr)
+{
+  a->reserve(a->size()+n);
+  for(size_t i=0; i < n; ++i, p += sizeof(U)) {
+    U u=xdr ? xdrValue<U>(p) : nativeValue<U>(p);
+    if(signedint) a->push((Int) (S) u);
+    else a->push(Intcast(u));
+  }
+}
+
+// Append n reals stored as S, with the bit pattern of U, to a.
+template<class S, class U>
+void appendReals(vm::array *a, const char *p, size_t n, bool xdr)
+{
+  a->reserve(a->size()+n);
+  for(size_t i=0; i < n; ++i, p += sizeof(U)) {
+    U u=xdr ? xdrValue<U>(p) : nativeValue<U>(p);
+    S x;
+    memcpy(&x,&u,sizeof(S));
+    a->push((double) x);
+  }
+}
+
+}
+
+void ibfile::readMapped(vm::array *a, size_t n, Int)
+{
+  size_t pos=fstream->tellg();
+  const char *p=map.at(pos);
+  if(singleint) appendInts<int,unsigned>(a,p,n,signedint,false);
+  else appendInts<Int,unsignedInt>(a,p,n,signedint,false);
+  fstream->seekg(pos+n*intSize());
+}
+
+void ibfile::readMapped(vm::array *a, size_t n, double)
+{
+  size_t pos=fstream->tellg();
+  const char *p=map.at(pos);
+  if(singlereal) appendReals<float,unsigned>(a,p,n,false);
+  else appendReals<double,unsigned long long>(a,p,n,false);
+  fstream->seekg(pos+n*realSize());
+}
+
+#ifdef HAVE_RPC_RPC_H
+void ixfile::readMapped(vm::array *a, size_t n, Int)
+{
+  size_t pos=fstream->tell();
+  const char *p=map.at(pos);
+  if(singleint) appendInts<int,unsigned>(a,p,n,signedint,true);
+  else appendInts<long long,unsigned long long>(a,p,n,signedint,true);
+  fstream->seek(pos+n*intSize());
+}
+
+void ixfile::readMapped(vm::array *a, size_t n, double)
+{
+  size_t pos=fstream->tell();
+  const char *p=map.at(pos);
+  if(singlereal) appendReals<float,unsigned>(a,p,n,true);
+  else appendReals<double,unsigned long long>(a,p,n,true);
+  fstream->seek(pos+n*realSize());
+}
+#endif
+
 } // namespace camp
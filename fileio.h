@@ -28,9 +28,11 @@
 #include "errormsg.h"
 #include "util.h"
 #include "process.h"
+#include "tablereader.h"
 
 namespace vm {
 extern bool indebugger;  
+class array;
 }
 
 namespace camp {
@@ -72,6 +74,7 @@ protected:
   bool singlereal; // Read/write single-precision XDR/binary reals.
   bool singleint;  // Read/write single-precision XDR/binary ints.
   bool signedint;  // Read/write signed XDR/binary ints.
+  bool mapped;     // Read XDR/binary arrays through a memory map.
   
   bool closed;     // File has been closed.
   bool standard;   // Standard input/output
@@ -117,8 +120,8 @@ public:
   file(const string& name, bool check=true, Mode type=NOMODE, bool binary=false,
        bool closed=false) : 
     name(name), check(check), type(type), linemode(false), csvmode(false),
-    singlereal(false), singleint(true), signedint(true),
-    closed(closed), standard(name.empty()),
+    wordmode(false), singlereal(false), singleint(true), signedint(true),
+    mapped(false), closed(closed), standard(name.empty()),
     binary(binary), nullfield(false), whitespace("") {dimension();}
   
   virtual void open() {}
@@ -193,6 +196,21 @@ public:
   virtual void ignoreComment() {};
   virtual void csv() {};
   
+  // Return the rows buffered by readTable to the text stream.
+  virtual void endTable() {}
+  
+  // Return the number of integers (reals) remaining in the memory map of an
+  // XDR/binary input file, or -1 if the file cannot be mapped.
+  virtual Int mappedCount(Int) {return -1;}
+  virtual Int mappedCount(double) {return -1;}
+  
+  // Append n integers (reals) from the memory map to a.
+  virtual void readMapped(vm::array *, size_t, Int) {}
+  virtual void readMapped(vm::array *, size_t, double) {}
+  
+  // Read up to n rows (all remaining rows if n is 0) of reals in bulk.
+  virtual vm::array *readTable(size_t, bool) {noread("real[][]"); return NULL;}
+  
   template<class T>
   void ignoreComment(T&) {
     ignoreComment();
@@ -205,6 +223,7 @@ public:
   void read(T& val) {
     if(binary) Read(val);
     else {
+      endTable();
       if(standard) clear();
       if(errorstream::interrupt) throw interrupted();
       else {
@@ -243,6 +262,31 @@ public:
   
   void SignedInt(bool b) {signedint=b;}
   bool SignedInt() {return signedint;}
+  
+  void Mapped(bool b) {mapped=b;}
+  bool Mapped() {return mapped;}
+};
+
+// A read-only memory map of an input file, used to read XDR/binary arrays
+// in bulk without per-value stream calls or an intermediate copy.
+class memorymap {
+  string name;
+  char *data;
+  size_t length;
+public:
+  memorymap() : data(NULL), length(0) {}
+  ~memorymap() {close();}
+  
+  // Map the named file, returning false on failure.
+  bool open(const string& filename);
+  void close();
+  
+  // Return the number of values of the given size stored after offset pos.
+  Int count(Int pos, size_t size) {
+    return pos < 0 || (size_t) pos > length ? 0 : (length-pos)/size;
+  }
+  
+  const char *at(size_t pos) {return data+pos;}
 };
 
 class opipe : public file {
@@ -332,17 +376,18 @@ protected:
   char comment;
   std::ios::openmode mode;
   bool comma;
+  tablereader *table;
   
 public:
   ifile(const string& name, char comment, bool check=true, Mode type=INPUT, 
         std::ios::openmode mode=std::ios::in) :
     file(name,check,type), stream(&cin), fstream(NULL), comment(comment),
-    mode(mode), comma(false) {}
+    mode(mode), comma(false), table(NULL) {}
   
   // Binary file
   ifile(const string& name, bool check=true, Mode type=BINPUT,
         std::ios::openmode mode=std::ios::in) :
-    file(name,check,type,true), mode(mode) {}
+    file(name,check,type,true), mode(mode), table(NULL) {}
   
   ~ifile() {close();}
   
@@ -372,10 +417,12 @@ public:
   bool nexteol();
   
   bool text() {return true;}
-  bool eof() {return stream->eof();}
+  bool eof() {return table ? table->eof() : stream->eof();}
   bool error() {return stream->fail();}
   
   void close() {
+    delete table;
+    table=NULL;
     if(!standard && fstream) {
       fstream->close();
       closed=true;
@@ -388,6 +435,8 @@ public:
   void clear() {stream->clear();}
   
   void seek(Int pos, bool begin=true) {
+    delete table;
+    table=NULL;
     if(!standard && fstream) {
       clear();
       fstream->seekg(pos,begin ? std::ios::beg : std::ios::end);
@@ -395,6 +444,7 @@ public:
   }
   
   size_t tell() {
+    endTable();
     if(fstream) 
       return fstream->tellg();
     else
@@ -403,6 +453,9 @@ public:
   
   void csv();
   
+  vm::array *readTable(size_t n, bool ahead);
+  void endTable();
+  
   virtual void ignoreComment();
   
   // Skip over white space
@@ -518,10 +571,41 @@ public:
 };
 
 class ibfile : public ifile {
+  memorymap map;
+  
+  // Map the file, returning the current read position, or -1 on failure.
+  Int mappedPos() {
+    if(!mapped || type != BINPUT || !fstream || !map.open(name)) return -1;
+    return fstream->tellg();
+  }
+  
+  size_t intSize() {return singleint ? sizeof(int) : sizeof(Int);}
+  size_t realSize() {return singlereal ? sizeof(float) : sizeof(double);}
+  
 public:
   ibfile(const string& name, bool check=true, Mode type=BINPUT,
          std::ios::openmode mode=std::ios::in) : 
     ifile(name,check,type,mode | std::ios::binary) {}
+  
+  bool text() {return false;}
+  
+  void close() {
+    map.close();
+    ifile::close();
+  }
+  
+  Int mappedCount(Int) {
+    Int pos=mappedPos();
+    return pos < 0 ? -1 : map.count(pos,intSize());
+  }
+  Int mappedCount(double) {
+    Int pos=mappedPos();
+    return pos < 0 ? -1 : map.count(pos,realSize());
+  }
+  
+  void readMapped(vm::array *a, size_t n, Int);
+  void readMapped(vm::array *a, size_t n, double);
+  
   template<class T>
   void iread(T& val) {
     val=T();
@@ -593,6 +677,8 @@ class obfile : public ofile {
 public:
   obfile(const string& name) : ofile(name,BOUTPUT,std::ios::binary) {}
 
+  bool text() {return false;}
+
   template<class T>
   void iwrite(T val) {
     if(fstream) fstream->write((char *) &val,sizeof(T));
@@ -635,6 +721,25 @@ class ixfile : public file {
 protected:  
   xdr::ioxstream *fstream;
   xdr::xios::open_mode mode;
+  memorymap map;
+  
+  // Map the file, returning the current read position, or -1 on failure.
+  Int mappedPos() {
+    if(!mapped || type != XINPUT || !fstream || !map.open(name)) return -1;
+    return fstream->tell();
+  }
+  
+  // XDR encodes single integers and reals in 4 bytes, and long long
+  // integers and double reals in 8 bytes.
+  size_t intSize() {
+#ifdef HAVE_LONG_LONG
+    return singleint ? 4 : 8;
+#else
+    return singleint ? 4 : 0;
+#endif    
+  }
+  size_t realSize() {return singlereal ? 4 : 8;}
+  
 public:
   ixfile(const string& name, bool check=true, Mode type=XINPUT,
          xdr::xios::open_mode mode=xdr::xios::in) :
@@ -647,6 +752,7 @@ public:
   }
     
   void close() {
+    map.close();
     if(fstream) {
       fstream->close();
       closed=true;
@@ -658,6 +764,19 @@ public:
   
   ~ixfile() {close();}
   
+  Int mappedCount(Int) {
+    Int pos=mappedPos();
+    size_t size=intSize();
+    return pos < 0 || size == 0 ? -1 : map.count(pos,size);
+  }
+  Int mappedCount(double) {
+    Int pos=mappedPos();
+    return pos < 0 ? -1 : map.count(pos,realSize());
+  }
+  
+  void readMapped(vm::array *a, size_t n, Int);
+  void readMapped(vm::array *a, size_t n, double);
+  
   bool eof() {return fstream ? fstream->eof() : true;}
   bool error() {return fstream ? fstream->fail() : true;}
 
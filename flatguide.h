@@ -183,6 +183,18 @@ public:
       return p;
     }
   }
+
+  // Yield a path from the guide as represented here, reusing the solution
+  // of an earlier state of the guide held in cache, and leaving the guide
+  // open to further additions.
+  path solve(solvecache& cache) {
+    if (solved)
+      return p;
+    else {
+      simpleknotlist l=list();
+      return camp::solve(l,&cache);
+    }
+  }
 };
 
 } // namespace camp
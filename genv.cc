@@ -28,6 +28,7 @@
 #include "locate.h"
 #include "interact.h"
 #include "builtin.h"
+#include "modulecache.h"
 
 using namespace types;
 using settings::getSetting;
@@ -72,6 +73,9 @@ record *genv::loadModule(symbol id, string filename) {
   }
 #endif
 
+  modulecache::begin();
+  modulecache::source(filename);
+
   // Get the abstract syntax tree.
   absyntax::file *ast = parser::parseFile(filename,"Loading");
 
@@ -83,6 +87,9 @@ record *genv::loadModule(symbol id, string filename) {
   
   inTranslation.remove(filename);
 
+  em.sync();
+  modulecache::end(filename, em.errors() ? 0 : r);
+
   return r;
 }
 
@@ -99,9 +106,25 @@ void genv::checkRecursion(string filename) {
 record *genv::getModule(symbol id, string filename) {
   checkRecursion(filename);
 
+  modulecache::import(id, filename);
+
   record *r=imap[filename];
-  if (r)
+  if (r) {
+    modulecache::depend(filename);
     return r;
+  }
+
+  // Reuse a translation from an earlier environment, registering the modules
+  // it imports so that they can be initialized at runtime.
+  modulecache::importList imports;
+  r=modulecache::lookup(filename, imports);
+  if (r) {
+    for (modulecache::importList::iterator p=imports.begin();
+         p != imports.end(); ++p)
+      getModule(p->first, p->second);
+    imap[filename]=r;
+    return r;
+  }
   else {
     record *r=loadModule(id, filename);
     // Don't add an erroneous module to the dictionary in interactive mode, as
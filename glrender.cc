@@ -15,9 +15,9 @@
 
 #include "common.h"
 
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
 
-#ifdef HAVE_LIBGLUT
+#if defined(HAVE_GL) && defined(HAVE_LIBGLUT)
 #ifdef __MSDOS__
 #ifndef FGAPI
 #define FGAPI GLUTAPI
@@ -35,6 +35,9 @@
 #include "bbox3.h"
 #include "drawimage.h"
 #include "interact.h"
+#include "swrender.h"
+
+#ifdef HAVE_GL
 #include "tr.h"
 
 #ifdef HAVE_LIBGLUT
@@ -42,6 +45,7 @@
 #include <GL/freeglut_ext.h>
 #endif
 #endif
+#endif
 
 namespace camp {
 billboard BB;
@@ -58,6 +62,7 @@ using camp::drawRawImage;
 using camp::transform;
 using camp::pair;
 using camp::triple;
+using camp::software;
 using vm::array;
 using vm::read;
 using camp::bbox3;
@@ -73,7 +78,7 @@ int Fitscreen;
 bool queueExport=false;
 bool readyAfterExport=false;
 
-#ifdef HAVE_LIBGLUT
+#if defined(HAVE_GL) && defined(HAVE_LIBGLUT)
 timeval lasttime;
 timeval lastframetime;
 int oldWidth,oldHeight;
@@ -149,7 +154,7 @@ GLUnurbs *nurb=NULL;
 
 void *glrenderWrapper(void *a);
 
-#ifdef HAVE_LIBOSMESA
+#if defined(HAVE_GL) && defined(HAVE_LIBOSMESA)
 OSMesaContext ctx;
 unsigned char *osmesa_buffer;
 #endif
@@ -190,6 +195,7 @@ inline T max(T a, T b)
   return (a > b) ? a : b;
 }
 
+#ifdef HAVE_GL
 void lighting()
 {
   for(size_t i=0; i < Nlights; ++i) {
@@ -236,6 +242,7 @@ void initlighting()
   if(ViewportLighting)
     lighting();
 }
+#endif
 
 void setDimensions(int Width, int Height, double X, double Y)
 {
@@ -275,6 +282,7 @@ void setDimensions(int Width, int Height, double X, double Y)
   }
 }
 
+#ifdef HAVE_GL
 void setProjection()
 {
   glMatrixMode(GL_PROJECTION);
@@ -290,22 +298,29 @@ void setProjection()
   arcball.set_params(vec2(0.5*Width,0.5*Height),arcballRadius*Zoom);
 #endif
 }
+#endif
 
-void drawscene(double Width, double Height)
+// Draw the nodes of the picture, or only the given nodes.
+void drawscene(double Width, double Height,
+               const std::vector<camp::drawElement *> *nodes=NULL)
 {
 #ifdef HAVE_PTHREAD
   static bool first=true;
-  if(glthread && first && !getSetting<bool>("offscreen")) {
+  if(glthread && first && !getSetting<bool>("offscreen") && !software) {
     wait(initSignal,initLock);
     endwait(initSignal,initLock);
     first=false;
   }
 #endif
 
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+#ifdef HAVE_GL
+  if(!software) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  if(!ViewportLighting) 
-    lighting();
+    if(!ViewportLighting) 
+      lighting();
+  }
+#endif
     
   triple m(xmin,ymin,zmin);
   triple M(xmax,ymax,zmax);
@@ -314,14 +329,26 @@ void drawscene(double Width, double Height)
   double size2=hypot(Width,Height);
   
   // Render opaque objects
-  Picture->render(nurb,size2,m,M,perspective,Nlights,false);
+  if(nodes)
+    picture::render(*nodes,nurb,size2,m,M,perspective,Nlights,false);
+  else
+    Picture->render(nurb,size2,m,M,perspective,Nlights,false);
   
   // Enable transparency
-  glDepthMask(GL_FALSE);
+  if(software) software->setDepthMask(false);
+#ifdef HAVE_GL
+  else glDepthMask(GL_FALSE);
+#endif
   
   // Render transparent objects
-  Picture->render(nurb,size2,m,M,perspective,Nlights,true);
-  glDepthMask(GL_TRUE);
+  if(nodes)
+    picture::render(*nodes,nurb,size2,m,M,perspective,Nlights,true);
+  else
+    Picture->render(nurb,size2,m,M,perspective,Nlights,true);
+  if(software) software->setDepthMask(true);
+#ifdef HAVE_GL
+  else glDepthMask(GL_TRUE);
+#endif
 }
 
 // Return x divided by y rounded up to the nearest integer.
@@ -330,6 +357,84 @@ int Quotient(int x, int y)
   return (x+y-1)/y;
 }
 
+#ifdef HAVE_GL
+// Select the nodes of a picture to draw in each tile of an exported image
+// from their bounding boxes in eye coordinates, which are computed once.
+class tiler {
+  std::vector<camp::drawElement *> nodes;
+  std::vector<camp::bbox3> boxes;
+  std::vector<camp::drawElement *> visible;
+public:
+  tiler(const picture *pic) {
+    double t[16],T[16];
+    glGetDoublev(GL_MODELVIEW_MATRIX,t);
+    // Like Fortran, OpenGL uses transposed (column-major) format!
+    for(int i=0; i < 4; ++i)
+      for(int j=0; j < 4; ++j)
+        T[4*i+j]=t[4*j+i];
+    for(picture::nodelist::const_iterator p=pic->nodes.begin();
+        p != pic->nodes.end(); ++p) {
+      camp::bbox3 b;
+      // Billboards are rotated to face the camera when they are drawn, so
+      // the bounds of their unrotated control points cannot be used.
+      if(!(*p)->billboard())
+        (*p)->bounds(T,b);
+      nodes.push_back(*p);
+      boxes.push_back(b);
+    }
+  }
+  
+  // Return the nodes that may be visible through the tile with the given
+  // bounds on the near clipping plane. Nodes without a bounding box are
+  // always drawn.
+  const std::vector<camp::drawElement *>& select(double left, double right,
+                                                 double bottom, double top) {
+    double perspective=orthographic ? 0.0 : 1.0/zmax;
+    visible.clear();
+    for(size_t i=0; i < nodes.size(); ++i) {
+      const camp::bbox3& b=boxes[i];
+      if(!b.empty) {
+        triple m=b.Min();
+        triple M=b.Max();
+        if(perspective) {
+          double f=m.getz()*perspective;
+          double F=M.getz()*perspective;
+          if(M.getx() < min(f*left,F*left) || m.getx() > max(f*right,F*right) ||
+             M.gety() < min(f*bottom,F*bottom) || m.gety() > max(f*top,F*top))
+            continue;
+        } else {
+          if(M.getx() < left || m.getx() > right ||
+             M.gety() < bottom || m.gety() > top)
+            continue;
+        }
+      }
+      visible.push_back(nodes[i]);
+    }
+    return visible;
+  }
+};
+#endif
+
+// Ship out the rendered image data, of size fullWidth x fullHeight, in RGB
+// format starting from the bottom row.
+void shipImage(unsigned char *data)
+{
+  picture pic;
+  double w=oWidth;
+  double h=oHeight;
+  double Aspect=((double) fullWidth)/fullHeight;
+  if(w > h*Aspect) w=(int) (h*Aspect+0.5);
+  else h=(int) (w/Aspect+0.5);
+  // Render an antialiased image.
+  drawRawImage *Image=new drawRawImage(data,fullWidth,fullHeight,
+                                       transform(0.0,0.0,w,0.0,0.0,h),
+                                       antialias);
+  pic.append(Image);
+  pic.shipout(NULL,Prefix,Format,false,View);
+  delete Image;
+}
+
+#ifdef HAVE_GL
 void Export()
 {
   glReadBuffer(GL_BACK_LEFT);
@@ -355,29 +460,28 @@ void Export()
       setDimensions(fullWidth,fullHeight,X/Width*fullWidth,Y/Width*fullWidth);
       (orthographic ? trOrtho : trFrustum)(tr,xmin,xmax,ymin,ymax,-zmax,-zmin);
    
+      // Lines and points are widened by a margin of two pixels, since their
+      // bounding boxes do not account for their widths in pixels.
+      double margin=2.0;
+      double xscale=(xmax-xmin)/fullWidth;
+      double yscale=(ymax-ymin)/fullHeight;
+      tiler Tiler(Picture);
+      
       size_t count=0;
       do {
         trBeginTile(tr);
-        drawscene(fullWidth,fullHeight);
+        double left=xmin+xscale*(trGet(tr,TR_CURRENT_COLUMN)*width-margin);
+        double bottom=ymin+yscale*(trGet(tr,TR_CURRENT_ROW)*height-margin);
+        double right=left+xscale*(trGet(tr,TR_CURRENT_TILE_WIDTH)+2*margin);
+        double top=bottom+yscale*(trGet(tr,TR_CURRENT_TILE_HEIGHT)+2*margin);
+        drawscene(fullWidth,fullHeight,&Tiler.select(left,right,bottom,top));
         ++count;
       } while (trEndTile(tr));
       if(settings::verbose > 1)
         cout << count << " tile" << (count != 1 ? "s" : "") << " drawn" << endl;
       trDelete(tr);
 
-      picture pic;
-      double w=oWidth;
-      double h=oHeight;
-      double Aspect=((double) fullWidth)/fullHeight;
-      if(w > h*Aspect) w=(int) (h*Aspect+0.5);
-      else h=(int) (w/Aspect+0.5);
-      // Render an antialiased image.
-      drawRawImage *Image=new drawRawImage(data,fullWidth,fullHeight,
-                                           transform(0.0,0.0,w,0.0,0.0,h),
-                                           antialias);
-      pic.append(Image);
-      pic.shipout(NULL,Prefix,Format,false,View);
-      delete Image;
+      shipImage(data);
       delete[] data;
     } 
   } catch(handled_error) {
@@ -1269,6 +1373,7 @@ void exportHandler(int=0)
 #endif  
   glutDisplayFunc(nodisplay);
 }
+#endif
 
 static bool glinitialize=true;
 
@@ -1318,6 +1423,7 @@ projection camera(bool user)
                          Y/Height*lastzoom+Shift.gety()));
 }
 
+#ifdef HAVE_GL
 void init() 
 {
 #ifdef HAVE_LIBGLUT
@@ -1374,6 +1480,68 @@ void init_osmesa()
   }
 #endif // HAVE_LIBOSMESA
 }
+#endif
+
+// Return the number of pixels to render per bp, which is doubled when
+// antialiasing.
+double expansion()
+{
+  antialias=getSetting<Int>("antialias") > 1;
+  double expand=getSetting<double>("render");
+  if(expand < 0)
+    expand *= (Format.empty() || Format == "eps" || Format == "pdf") 
+      ? -2.0 : -1.0;
+  if(antialias) expand *= 2.0;
+  return expand;
+}
+
+// Render the picture at full size with the software rasterizer and ship
+// it out; no OpenGL context is required.
+void softwareExport(double width, double height)
+{
+  double expand=expansion();
+  oWidth=width;
+  oHeight=height;
+  fullWidth=Width=(int) ceil(expand*width);
+  fullHeight=Height=(int) ceil(expand*height);
+  
+  X=Y=cx=cy=0.0;
+  lastzoom=Zoom=Zoom0;
+  outlinemode=false;
+  setDimensions(fullWidth,fullHeight,0,0);
+
+  if(settings::verbose > 1) 
+    cout << "Rendering " << Prefix << " as " << fullWidth << "x" 
+         << fullHeight << " image in software" << endl;
+  
+  try {
+    camp::rasterizer R(fullWidth,fullHeight,Background);
+    if(orthographic)
+      R.ortho(xmin,xmax,ymin,ymax,-zmax,-zmin);
+    else
+      R.frustum(xmin,xmax,ymin,ymax,-zmax,-zmin);
+  
+    // The modelview matrix is the identity, as after home().
+    R.setTwoSided(getSetting<bool>("twosided"));
+    for(size_t i=0; i < Nlights; ++i) {
+      size_t i4=4*i;
+      R.addLight(Lights[i],Diffuse+i4,Ambient+i4,Specular+i4);
+    }
+    
+    size_t ndata=3*fullWidth*fullHeight;
+    unsigned char *data=new unsigned char[ndata];
+    software=&R;
+    drawscene(fullWidth,fullHeight);
+    R.finish(data,settings::threadCount());
+    software=NULL;
+    shipImage(data);
+    delete[] data;
+  } catch(handled_error) {
+  } catch(std::bad_alloc&) {
+    outOfMemory();
+  }
+  software=NULL;
+}
 
 // angle=0 means orthographic.
 void glrender(const string& prefix, const picture *pic, const string& format,
@@ -1383,13 +1551,8 @@ void glrender(const string& prefix, const picture *pic, const string& format,
               double *diffuse, double *ambient, double *specular,
               bool Viewportlighting, bool view, int oldpid)
 {
-  bool offscreen=getSetting<bool>("offscreen");
   Iconify=getSetting<bool>("iconify");
   
-#ifdef HAVE_PTHREAD
-  static bool initializedView=false;
-#endif  
-
   width=max(width,1.0);
   height=max(height,1.0);
   
@@ -1431,6 +1594,18 @@ void glrender(const string& prefix, const picture *pic, const string& format,
   Mode=0;
   Xfactor=Yfactor=1.0;
   
+  if(getSetting<bool>("software")) {
+    softwareExport(width,height);
+    return;
+  }
+  
+#ifdef HAVE_GL
+  bool offscreen=getSetting<bool>("offscreen");
+  
+#ifdef HAVE_PTHREAD
+  static bool initializedView=false;
+#endif  
+
   pair maxtile=getSetting<pair>("maxtile");
   maxTileWidth=(int) maxtile.getx();
   maxTileHeight=(int) maxtile.gety();
@@ -1456,12 +1631,7 @@ void glrender(const string& prefix, const picture *pic, const string& format,
 
   static bool initialized=false;
   if(!initialized || !interact::interactive) {
-    antialias=getSetting<Int>("antialias") > 1;
-    double expand=getSetting<double>("render");
-    if(expand < 0)
-      expand *= (Format.empty() || Format == "eps" || Format == "pdf") 
-        ? -2.0 : -1.0;
-    if(antialias) expand *= 2.0;
+    double expand=expansion();
   
     // Force a hard viewport limit to work around direct rendering bugs.
     // Alternatively, one can use -glOptions=-indirect (with a performance
@@ -1702,6 +1872,7 @@ void glrender(const string& prefix, const picture *pic, const string& format,
       quit();
     }
   }
+#endif
 }
 
 } // namespace gl
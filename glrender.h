@@ -40,6 +40,26 @@ typedef GLvoid (* _GLUfuncptr)();
 #endif
 #endif
 
+#else
+
+// The OpenGL types and constants used by the renderer.
+typedef void GLUnurbs;
+typedef float GLfloat;
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+
+#define GL_FRONT 0x0404
+#define GL_FRONT_AND_BACK 0x0408
+#define GL_MAX_LIGHTS 0x0D31
+#define GL_AMBIENT 0x1200
+#define GL_DIFFUSE 0x1201
+#define GL_SPECULAR 0x1202
+#define GL_EMISSION 0x1600
+
+#endif
+
+#ifdef HAVE_RENDER
+
 namespace camp {
 class picture;
 
@@ -142,9 +162,6 @@ extern billboard BB;
 
 }
 
-#else
-typedef void GLUnurbs;
-typedef float GLfloat;
 #endif
 
 #endif
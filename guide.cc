@@ -15,10 +15,13 @@ multiguide::multiguide(guidevector& v)
     multiguide *rg = v.empty() ? 0 : dynamic_cast<multiguide *>(v[0]);
     if (rg && rg->base->size() == rg->length) {
         base = rg->base;
+        cache = rg->cache;
         base->insert(base->end(), v.begin()+1, v.end());
     }
-    else
+    else {
         base = new guidevector(v);
+        cache = new flatcache;
+    }
 
     length = base->size();
 }
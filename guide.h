@@ -224,6 +224,17 @@ public:
 // tensions in between.
 typedef mem::vector<guide *> guidevector;
 
+// The first "length" subguides of a base vector, flattened, and the
+// solution of the last guide solved on that base, from which longer guides
+// sharing the base are flattened and solved incrementally.
+struct flatcache : public gc {
+  size_t length;
+  flatguide g;
+  solvecache solved;
+
+  flatcache() : length(0) {}
+};
+
 // A multiguide represents a guide given by the first "length" items of 
 // the vector pointed to by "base".
 // The constructor, if given another multiguide as a first argument,
@@ -231,6 +242,7 @@ typedef mem::vector<guide *> guidevector;
 class multiguide : public guide {
     guidevector *base;
     size_t length;
+    flatcache *cache;
 
     guide *subguide(size_t i) const
     {
@@ -257,9 +269,17 @@ public:
       print(cerr); cerr << "\n\n";
     }
     
-    flatguide g;
-    this->flatten(g);
-    path p=g.solve(false);
+    path p;
+    if (cache->length <= length) {
+      for (size_t i=cache->length; i < length; ++i)
+        subguide(i)->flatten(cache->g);
+      cache->length=length;
+      p=cache->g.solve(cache->solved);
+    } else {
+      flatguide g;
+      this->flatten(g);
+      p=g.solve(false);
+    }
 
     if (settings::verbose>3)
       cerr << "solved as:\n" << p << "\n\n";
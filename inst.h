@@ -56,6 +56,15 @@ struct lambda : public gc {
 #endif
 };
 
+// With GCC, the interpreter loop in stack.cc jumps directly from one
+// instruction to the next through the address of its handler (resolved when
+// the code is first run), rather than through a switch on the opcode.
+// Define NO_THREADED_DISPATCH to use the switch.
+#if defined(__GNUC__) && !defined(NO_THREADED_DISPATCH) && \
+  !defined(DEBUG_STACK)
+#define THREADED_DISPATCH
+#endif
+
 // The code run is just a string of instructions.  The ops are actual commands
 // to be run, but constants, labels, and other objects can be in the code.
 struct inst : public gc {
@@ -67,6 +76,9 @@ struct inst : public gc {
   opcode op;
   position pos;
   item ref;
+#ifdef THREADED_DISPATCH
+  void *handler;
+#endif
 };
 template<typename T>
 inline T get(const inst& it)
@@ -6,6 +6,8 @@
  * intermediate structure in solving paths.
  *****/
 
+#include <cmath>
+
 #include "knot.h"
 #include "util.h"
 
@@ -648,6 +650,99 @@ void solveSection(protopath& p, Int k, knotlist& l)
   }
 }
 
+// Compute a property of a non-cyclic knotlist of length n at j, as
+// linearCompute does.
+template<typename T, typename P>
+T linearAt(P& prop, Int j, Int n)
+{
+  return j == 0 ? prop.start(j) : j < n ? prop.mid(j) : prop.end(j);
+}
+
+inline bool same(double x, double y)
+{
+  return x == y && std::signbit(x) == std::signbit(y);
+}
+
+// Solve a non-cyclic section as above, keeping its properties in the cache.
+// If reuse is set, the cache holds those of a section that starts at the
+// same knot and shares all but the last two of its knots, and the protopath
+// holds its solution; the properties depending only on those knots are
+// kept, and the back-substitution stops at the first theta that comes out
+// as before, since all those preceding it then do too.
+void solveSection(protopath& p, Int k, knotlist& l, solvecache& c,
+                  bool reuse)
+{
+  Int n=l.length();
+  Int m=reuse ? (Int) c.theta.size()-1 : 0;
+
+  // The distances and turning angles at j depend on the knots up to j+1,
+  // and the equation at j on those up to j+2.
+  Int kept=m >= 3 && m <= n ? m : 0;
+  Int keptEqns=kept > 0 ? kept-1 : 0;
+
+  dzprop DZ(l);
+  c.dz.resize(n+1);
+  for (Int j=kept; j <= n; ++j)
+    c.dz[j]=linearAt<pair>(DZ,j,n);
+
+  dprop D(l,c.dz);
+  psiprop PSI(l,c.dz);
+  c.d.resize(n+1);
+  c.psi.resize(n+1);
+  for (Int j=kept; j <= n; ++j) {
+    c.d[j]=linearAt<double>(D,j,n);
+    c.psi[j]=linearAt<double>(PSI,j,n);
+  }
+
+  eqnprop E(l,c.d,c.psi);
+  c.e.resize(n+1,eqn(0,0,0,0));
+  for (Int j=keptEqns; j <= n; ++j)
+    c.e[j]=linearAt<eqn>(E,j,n);
+
+  if (straightSection(c.e)) {
+    encodeStraight(p,k,l);
+    c.theta.clear();
+    return;
+  }
+
+  Int s=-1;
+  bool solved=!homogeneous(c.e);
+  if (solved) {
+    ref R(l,c.e);
+    c.el.resize(n+1,eqn(0,0,0,0));
+    if (keptEqns > 0)
+      R.lasteqn=c.el[keptEqns-1];
+    for (Int j=keptEqns; j <= n; ++j)
+      c.el[j]=j == 0 ? R.start(j) : R.mid(j);
+
+    cvector<double>& theta=c.theta;
+    theta.resize(n+1);
+    double lastTheta=theta[n]=c.el[n].aug;
+    for (s=n-1; s >= 0; --s) {
+      eqn& q=c.el[s];
+      double t=-q.post*lastTheta+q.aug;
+      if (s < keptEqns && same(t,theta[s]))
+        break;
+      theta[s]=lastTheta=t;
+    }
+  } else
+    c.theta.assign(n+1,0.0);
+
+  // The controls depending only on the unchanged thetas are already those
+  // of the protopath, which holds the cached one.
+  postcontrolprop post(l,c.dz,c.psi,c.theta);
+  precontrolprop pre(l,c.dz,c.psi,c.theta);
+  for (Int j=max(s,(Int) 0); j < n; ++j)
+    p.post(k+j)=post.mid(j);
+  for (Int j=max(s+1,(Int) 1); j <= n; ++j) {
+    p.pre(k+j)=pre.mid(j);
+    p.point(k+j)=l[j].z;
+  }
+
+  if (!solved)
+    c.theta.clear();
+}
+
 // Find the first breakpoint in the knotlist, ie. where we can start solving a
 // non-cyclic section.  If the knotlist is fully cyclic, then this returns
 // NOBREAK.
@@ -689,8 +784,10 @@ void writeControls(protopath& p, Int a, knotlist& l)
   p.point(a+1)=l[a+1].z;
 }
 
-// Solves a path that has all of its specifiers laid out explicitly.
-path solveSpecified(knotlist& l)
+// Solves a path that has all of its specifiers laid out explicitly.  Given a
+// cache for a non-cyclic path, the solution is recorded there; if the path
+// extends the one cached, the sections before its last one are copied.
+path solveSpecified(knotlist& l, solvecache *cache=NULL, bool extends=false)
 {
   protopath p(l.size(),l.cyclic());
 
@@ -707,29 +804,55 @@ path solveSpecified(knotlist& l)
     Int last=l.cyclic() ? first+l.length()
       : l.length();
     Int a=first;
+    if (extends) {
+      // Start from the cached path; only the last section of it, where no
+      // knot but the first is straight, is solved again.
+      a=cache->a;
+      p.nodes.swap(cache->nodes);
+      p.nodes.resize(p.n);
+      p.straight(a)=false;
+    }
+
+    if (cache && a==last) {
+      cache->a=a;
+      cache->theta.clear();
+    }
+
+    bool reuse=extends;
     while (a!=last) {
+      if (cache)
+        cache->a=a;
       if (l[a].out->controlled()) {
         assert(l[a+1].in->controlled());
 
         // Controls are already picked, just write them out.
         writeControls(p,a,l);
         ++a;
+        if (cache)
+          cache->theta.clear();
       }
       else {
         // Find the section a to b and solve it, putting the result (starting
         // from index a into our protopath.
         Int b=nextBreakpoint(l,a);
         subknotlist section(l,a,b);
-        solveSection(p,a,section);
+        if (cache)
+          solveSection(p,a,section,*cache,reuse);
+        else
+          solveSection(p,a,section);
         a=b;
       }
+      reuse=false;
     }
 
     // For a non-cyclic path, the end control points need to be set.
     p.controlEnds();
   }
 
-  return p.fix();
+  path g=p.fix();
+  if (cache)
+    cache->nodes.swap(p.nodes);
+  return g;
 }
 
 /* If a knot is open on one side and restricted on the other, this replaces the
@@ -784,17 +907,74 @@ struct controlDuplicates : public knoteffect {
   void end(Int) { /* No next point to compare with. */ }
 };
 
-path solve(knotlist& l)
+inline bool same(pair z, pair w)
+{
+  return same(z.getx(),w.getx()) && same(z.gety(),w.gety());
+}
+
+inline bool same(const tension& s, const tension& t)
+{
+  return same(s.val,t.val) && s.atleast == t.atleast;
+}
+
+// Checks whether the knots extend those cached: all but the last cached knot
+// must be repeated exactly, and the last one may differ only in how the path
+// leaves it.
+bool extending(cvector<knot>& cached, cvector<knot>& knots)
+{
+  size_t n=cached.size();
+  if (n == 0 || n > knots.size())
+    return false;
+  for (size_t j=0; j+1 < n; ++j) {
+    knot& k=cached[j];
+    knot& K=knots[j];
+    if (!same(k.z,K.z) || k.in != K.in || k.out != K.out ||
+        !same(k.tin,K.tin) || !same(k.tout,K.tout))
+      return false;
+  }
+  knot& k=cached[n-1];
+  knot& K=knots[n-1];
+  return same(k.z,K.z) && k.in == K.in && same(k.tin,K.tin);
+}
+
+path solve(knotlist& l, solvecache *cache)
 {
   if (l.empty())
     return path();
   else {
     info(cerr, "input knotlist", l);
+
+    if (l.cyclic())
+      cache=NULL;
+    bool extends=false;
+    cvector<knot> knots;
+    if (cache) {
+      Int n=l.size();
+      knots.reserve(n);
+      for (Int j=0; j < n; ++j)
+        knots.push_back(l[j]);
+      extends=extending(cache->knots,knots);
+      // The cache describes no knots until this solution is complete.
+      cache->knots.clear();
+    }
+
     curlEnds(l);
-    controlDuplicates(l).exec();
-    partnerUp(l).exec();
+    if (extends) {
+      // The knots before the last section of the cached path are not looked
+      // at again, except for any duplicate of its first knot.
+      subknotlist tail(l,max(cache->a-1,(Int) 0),l.length());
+      controlDuplicates(tail).exec();
+      partnerUp(tail).exec();
+    } else {
+      controlDuplicates(l).exec();
+      partnerUp(l).exec();
+    }
     info(cerr, "specified knotlist", l);
-    return solveSpecified(l);
+    path p=solveSpecified(l,cache,extends);
+
+    if (cache)
+      cache->knots.swap(knots);
+    return p;
   }
 }
 
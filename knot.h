@@ -519,7 +519,27 @@ public:
     : l(l) {}
 };
 
-path solve(knotlist& l);
+// The solution of a non-cyclic knotlist, kept so that a knotlist extending
+// it, such as the next in a chain of guides built up a join at a time, can
+// be solved without repeating the work for the sections they share.
+struct solvecache {
+  cvector<knot> knots;           // The knots as given to solve.
+  mem::vector<solvedKnot> nodes; // The solved path.
+  Int a;                         // The start of its last section.
+
+  // The properties of the last section, if it was solved as a system of
+  // equations; otherwise theta is empty.
+  cvector<pair> dz;
+  cvector<double> d,psi;
+  cvector<eqn> e,el;
+  cvector<double> theta;
+
+  solvecache() : a(0) {}
+};
+
+// Solve the knotlist, reusing and then updating the solution held in cache,
+// if any.
+path solve(knotlist& l, solvecache *cache=NULL);
 
 path solveSimple(cvector<pair>& z);
 
@@ -0,0 +1,280 @@
+/*****
+ * labelcache.cc
+ *
+ * Cache of TeX label metrics, keyed by the label text, the pen font, and the
+ * state of the TeX pipe (engine, preamble, and verbatim TeX).
+ *
+ * Entries are always reused within a run. If the labelcache setting is
+ * true, they are also appended to the file labelcache in the configuration
+ * directory as lines of the form "key width height depth", where key is a
+ * hexadecimal 64-bit FNV-1a digest. Outlines are appended to the file
+ * labelpaths as lines of the form "key n" followed, for each of the n paths,
+ * by its cyclic flag, its node count, and the precontrol, point, postcontrol,
+ * and straight flag of each node. The keys do not cover the contents of TeX
+ * packages or fonts, so saving is off by default.
+ *****/
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#include "labelcache.h"
+#include "settings.h"
+
+using settings::getSetting;
+
+namespace camp {
+
+namespace labelcache {
+
+typedef unsigned long long digest;
+
+struct metrics {
+  double width,height,depth;
+};
+
+typedef mem::map<digest,metrics> metricsmap;
+typedef mem::map<digest,mem::vector<path> > outlinemap;
+
+namespace {
+
+const digest FNVoffset=0xcbf29ce484222325ULL;
+const digest FNVprime=0x100000001b3ULL;
+
+metricsmap *table=NULL;
+bool loaded=false;
+std::ofstream *out=NULL;
+outlinemap *outlinetable=NULL;
+bool outlinesloaded=false;
+std::ofstream *outlineout=NULL;
+digest context=FNVoffset;
+Int Hits=0;
+Int Misses=0;
+
+digest hash(digest h, const string& s)
+{
+  for(string::const_iterator p=s.begin(); p != s.end(); ++p) {
+    h ^= (unsigned char) *p;
+    h *= FNVprime;
+  }
+  // Terminate each field so that concatenations remain distinct.
+  h ^= 0xff;
+  h *= FNVprime;
+  return h;
+}
+
+string filename()
+{
+  return settings::initdir+"/labelcache";
+}
+
+string outlinefilename()
+{
+  return settings::initdir+"/labelpaths";
+}
+
+bool enabled()
+{
+  return getSetting<bool>("labelcache");
+}
+
+// Read the entries saved by earlier runs, if the cache is persistent.
+void load()
+{
+  if(!table) table=new metricsmap;
+  if(loaded || !enabled()) return;
+  loaded=true;
+  std::ifstream fin(filename().c_str());
+  if(!fin) return;
+  string line;
+  while(getline(fin,line)) {
+    istringstream buf(line);
+    digest key;
+    metrics m;
+    if(buf >> std::hex >> key >> std::dec >> m.width >> m.height >> m.depth)
+      (*table)[key]=m;
+  }
+  if(settings::verbose > 1)
+    cerr << "Loaded " << table->size() << " label metrics from "
+         << filename() << endl;
+}
+
+void loadOutlines()
+{
+  if(!outlinetable) outlinetable=new outlinemap;
+  if(outlinesloaded || !enabled()) return;
+  outlinesloaded=true;
+  std::ifstream fin(outlinefilename().c_str());
+  if(!fin) return;
+  string line;
+  while(getline(fin,line)) {
+    istringstream buf(line);
+    digest key;
+    size_t n;
+    if(!(buf >> std::hex >> key >> std::dec >> n)) continue;
+    mem::vector<path> outlines;
+    // Skip lines truncated by an interrupted run.
+    bool valid=true;
+    for(size_t i=0; valid && i < n; ++i) {
+      bool cyclic;
+      size_t m;
+      valid=!(buf >> cyclic >> m).fail() && m > 0;
+      mem::vector<solvedKnot> nodes(valid ? m : 0);
+      for(size_t j=0; valid && j < m; ++j) {
+        double prex,prey,x,y,postx,posty;
+        bool straight;
+        valid=!(buf >> prex >> prey >> x >> y >> postx >> posty >>
+                straight).fail();
+        nodes[j].pre=pair(prex,prey);
+        nodes[j].point=pair(x,y);
+        nodes[j].post=pair(postx,posty);
+        nodes[j].straight=straight;
+      }
+      if(valid) outlines.push_back(path(nodes,m,cyclic));
+    }
+    if(valid) (*outlinetable)[key]=outlines;
+  }
+  if(settings::verbose > 1)
+    cerr << "Loaded " << outlinetable->size() << " label outlines from "
+         << outlinefilename() << endl;
+}
+
+string font(const pen& p)
+{
+  ostringstream font;
+  font << std::setprecision(std::numeric_limits<double>::digits10+2)
+       << p.Font() << " " << p.size() << " " << p.Lineskip();
+  return font.str();
+}
+
+digest key(const pen& p, const string& s, const string& size)
+{
+  return hash(hash(hash(context,font(p)),s),size);
+}
+
+digest key(const pen& p, const string& s, const string& method,
+           const mem::list<string>& preamble)
+{
+  digest h=hash(FNVoffset,method);
+  for(mem::list<string>::const_iterator q=preamble.begin();
+      q != preamble.end(); ++q)
+    h=hash(h,*q);
+  return hash(hash(h,font(p)),s);
+}
+
+}
+
+void reset(const string& texengine, const mem::list<string>& preamble)
+{
+  context=hash(FNVoffset,texengine);
+  for(mem::list<string>::const_iterator p=preamble.begin();
+      p != preamble.end(); ++p)
+    context=hash(context,*p);
+}
+
+void append(const string& s)
+{
+  context=hash(context,s);
+}
+
+bool lookup(const pen& p, const string& s, const string& size,
+            double& width, double& height, double& depth)
+{
+  load();
+  metricsmap::iterator m=table->find(key(p,s,size));
+  if(m == table->end()) {
+    ++Misses;
+    return false;
+  }
+  ++Hits;
+  width=m->second.width;
+  height=m->second.height;
+  depth=m->second.depth;
+  return true;
+}
+
+void store(const pen& p, const string& s, const string& size,
+           double width, double height, double depth)
+{
+  load();
+  digest k=key(p,s,size);
+  metrics m={width,height,depth};
+  (*table)[k]=m;
+  if(!enabled()) return;
+
+  if(!out) {
+    out=new std::ofstream(filename().c_str(),std::ios::app);
+    if(!*out) {
+      if(settings::verbose > 1)
+        cerr << "Cannot write to " << filename() << endl;
+      return;
+    }
+  }
+  if(*out) {
+    *out << std::hex << k << std::dec
+         << std::setprecision(std::numeric_limits<double>::digits10+2)
+         << " " << width << " " << height << " " << depth << endl;
+  }
+}
+
+bool lookup(const pen& p, const string& s, const string& method,
+            const mem::list<string>& preamble, mem::vector<path>& outlines)
+{
+  loadOutlines();
+  outlinemap::iterator m=outlinetable->find(key(p,s,method,preamble));
+  if(m == outlinetable->end()) return false;
+  outlines=m->second;
+  return true;
+}
+
+void store(const pen& p, const string& s, const string& method,
+           const mem::list<string>& preamble,
+           const mem::vector<path>& outlines)
+{
+  loadOutlines();
+  digest k=key(p,s,method,preamble);
+  (*outlinetable)[k]=outlines;
+  if(!enabled()) return;
+
+  if(!outlineout) {
+    outlineout=new std::ofstream(outlinefilename().c_str(),std::ios::app);
+    if(!*outlineout) {
+      if(settings::verbose > 1)
+        cerr << "Cannot write to " << outlinefilename() << endl;
+      return;
+    }
+  }
+  if(*outlineout) {
+    std::ofstream& o=*outlineout;
+    o << std::hex << k << std::dec
+      << std::setprecision(std::numeric_limits<double>::digits10+2)
+      << " " << outlines.size();
+    for(size_t i=0; i < outlines.size(); ++i) {
+      const path& g=outlines[i];
+      Int m=g.size();
+      o << " " << g.cyclic() << " " << m;
+      for(Int j=0; j < m; ++j) {
+        pair pre=g.precontrol(j), z=g.point(j), post=g.postcontrol(j);
+        o << " " << pre.getx() << " " << pre.gety()
+          << " " << z.getx() << " " << z.gety()
+          << " " << post.getx() << " " << post.gety()
+          << " " << g.straight(j);
+      }
+    }
+    o << endl;
+  }
+}
+
+Int hits()
+{
+  return Hits;
+}
+
+Int misses()
+{
+  return Misses;
+}
+
+}
+
+}
@@ -0,0 +1,52 @@
+/*****
+ * labelcache.h
+ *
+ * Cache of TeX label metrics, keyed by the label text, the pen
+ * font, and the state of the TeX pipe (engine, preamble, and verbatim TeX),
+ * and of the label outlines extracted by texpath and textpath.
+ *****/
+
+#ifndef LABELCACHE_H
+#define LABELCACHE_H
+
+#include "common.h"
+#include "pen.h"
+#include "path.h"
+
+namespace camp {
+
+namespace labelcache {
+
+// Start a new TeX pipe context for the given engine and preamble.
+void reset(const string& texengine, const mem::list<string>& preamble);
+
+// Fold TeX code sent to the pipe outside of a label into the context.
+void append(const string& s);
+
+// Look up the metrics of label s (or of size, if s has no extent) in pen p.
+bool lookup(const pen& p, const string& s, const string& size,
+            double& width, double& height, double& depth);
+
+// Record the metrics of label s (or of size) in pen p.
+void store(const pen& p, const string& s, const string& size,
+           double width, double height, double depth);
+
+// Look up the outlines of label s in pen p, as extracted by method (which
+// identifies the pipeline and any settings affecting its output) after the
+// given preamble.
+bool lookup(const pen& p, const string& s, const string& method,
+            const mem::list<string>& preamble, mem::vector<path>& outlines);
+
+// Record the outlines of label s in pen p.
+void store(const pen& p, const string& s, const string& method,
+           const mem::list<string>& preamble,
+           const mem::vector<path>& outlines);
+
+Int hits();
+Int misses();
+
+}
+
+}
+
+#endif
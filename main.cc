@@ -206,6 +206,16 @@ int main(int argc, char *argv[])
     em.statusError();
   }
 
+  string client=getSetting<string>("client");
+  if(!client.empty())
+    exit(processClient(client,argc,argv));
+
+  string server=getSetting<string>("server");
+  if(!server.empty()) {
+    processServer(server);
+    exit(em.processStatus() ? 0 : 1);
+  }
+
   Args args(argc,argv);
 #ifdef HAVE_GL
 #ifdef __APPLE__
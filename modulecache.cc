@@ -0,0 +1,194 @@
+/*****
+ * modulecache.cc
+ *
+ * Cache of translated modules that outlives a single global environment.
+ *
+ * A module is cached with the located file it was loaded from and the size,
+ * modification time, and 64-bit FNV-1a digest of every source file read
+ * while translating it, including those of its imports and includes. A
+ * touched but unchanged file is recognized by its digest.
+ *****/
+
+#include <fstream>
+#include <sys/stat.h>
+
+#include "modulecache.h"
+#include "record.h"
+#include "settings.h"
+#include "locate.h"
+
+using settings::getSetting;
+
+namespace trans {
+
+namespace modulecache {
+
+typedef unsigned long long digest;
+
+struct sourceFile {
+  string path;
+  time_t mtime;
+  off_t size;
+  digest hash;
+};
+
+typedef mem::vector<sourceFile> sourceList;
+
+// The sources and imports of a module being translated.
+struct recording : public gc {
+  sourceList sources;
+  importList imports;
+};
+
+struct entry : public gc {
+  string path;
+  types::record *r;
+  recording *rec;
+};
+
+typedef mem::map<CONST string,entry *> entryMap;
+
+namespace {
+
+entryMap *cache=NULL;
+mem::list<recording *> *recordings=NULL;
+
+bool enabled()
+{
+  return getSetting<bool>("modulecache");
+}
+
+// Modules translated without autoplain do not see plain.
+string key(const string& filename)
+{
+  return getSetting<bool>("autoplain") ? filename : filename+"\n-autoplain";
+}
+
+digest hashFile(const string& path)
+{
+  const digest FNVprime=0x100000001b3ULL;
+  digest h=0xcbf29ce484222325ULL;
+  std::ifstream fin(path.c_str(),std::ios::binary);
+  char buf[8192];
+  while(fin.read(buf,sizeof(buf)) || fin.gcount() > 0) {
+    std::streamsize n=fin.gcount();
+    for(std::streamsize i=0; i < n; ++i) {
+      h ^= (unsigned char) buf[i];
+      h *= FNVprime;
+    }
+  }
+  return h;
+}
+
+bool current(sourceFile& s)
+{
+  struct stat buf;
+  if(stat(s.path.c_str(),&buf) != 0) return false;
+  if(buf.st_mtime == s.mtime && buf.st_size == s.size) return true;
+  if(buf.st_size != s.size || hashFile(s.path) != s.hash) return false;
+  s.mtime=buf.st_mtime;
+  return true;
+}
+
+recording *top()
+{
+  return recordings && !recordings->empty() ? recordings->back() : NULL;
+}
+
+void add(recording *rec, const sourceFile& s)
+{
+  for(sourceList::iterator p=rec->sources.begin(); p != rec->sources.end();
+      ++p)
+    if(p->path == s.path) return;
+  rec->sources.push_back(s);
+}
+
+// Add the sources of a cached module to the module being translated.
+void merge(const string& filename)
+{
+  recording *rec=top();
+  if(!rec || !cache) return;
+  entryMap::iterator p=cache->find(key(filename));
+  if(p == cache->end()) return;
+  sourceList& sources=p->second->rec->sources;
+  for(sourceList::iterator q=sources.begin(); q != sources.end(); ++q)
+    add(rec,*q);
+}
+
+}
+
+types::record *lookup(const string& filename, importList& imports)
+{
+  if(!cache || !enabled()) return NULL;
+  entryMap::iterator p=cache->find(key(filename));
+  if(p == cache->end()) return NULL;
+  entry *e=p->second;
+
+  bool valid=settings::locateFile(filename) == e->path;
+  sourceList& sources=e->rec->sources;
+  for(sourceList::iterator q=sources.begin(); valid && q != sources.end();
+      ++q)
+    valid=current(*q);
+  if(!valid) {
+    cache->erase(p);
+    return NULL;
+  }
+
+  if(settings::verbose > 1)
+    cerr << "Reusing " << filename << " from " << e->path << endl;
+  merge(filename);
+  imports=e->rec->imports;
+  return e->r;
+}
+
+void begin()
+{
+  if(!enabled()) return;
+  if(!recordings) recordings=new mem::list<recording *>;
+  recordings->push_back(new recording);
+}
+
+void end(const string& filename, types::record *r)
+{
+  recording *rec=top();
+  if(!rec) return;
+  recordings->pop_back();
+  if(!r || !enabled()) return;
+
+  if(!cache) cache=new entryMap;
+  entry *e=new entry;
+  e->path=settings::locateFile(filename);
+  e->r=r;
+  e->rec=rec;
+  (*cache)[key(filename)]=e;
+  merge(filename);
+}
+
+void source(const string& filename)
+{
+  recording *rec=top();
+  if(!rec) return;
+  sourceFile s;
+  s.path=settings::locateFile(filename);
+  struct stat buf;
+  if(s.path.empty() || stat(s.path.c_str(),&buf) != 0) return;
+  s.mtime=buf.st_mtime;
+  s.size=buf.st_size;
+  s.hash=hashFile(s.path);
+  add(rec,s);
+}
+
+void import(sym::symbol id, const string& filename)
+{
+  recording *rec=top();
+  if(rec) rec->imports.push_back(std::make_pair(id,filename));
+}
+
+void depend(const string& filename)
+{
+  merge(filename);
+}
+
+}
+
+}
@@ -0,0 +1,53 @@
+/*****
+ * modulecache.h
+ *
+ * Cache of translated modules that outlives a single global environment, so
+ * that a process running several files (or resetting the interactive
+ * prompt) translates plain and other imports only once. Each module records
+ * the source files it was built from, including those of its own imports
+ * and includes, and is retranslated if any of them change.
+ *****/
+
+#ifndef MODULECACHE_H
+#define MODULECACHE_H
+
+#include "common.h"
+#include "symbol.h"
+
+namespace types {
+class record;
+}
+
+namespace trans {
+
+namespace modulecache {
+
+typedef mem::vector<std::pair<sym::symbol,string> > importList;
+
+// Return the cached translation of the module imported as filename, if its
+// sources are unchanged, or NULL. The modules it imports, which must also be
+// registered in the environment, are returned in imports.
+types::record *lookup(const string& filename, importList& imports);
+
+// Start recording the sources of a module being translated.
+void begin();
+
+// Stop recording the sources of the module imported as filename, caching
+// its translation r unless it is NULL.
+void end(const string& filename, types::record *r);
+
+// Record that the module being translated reads the given source file.
+void source(const string& filename);
+
+// Record that the module being translated imports the module filename.
+void import(sym::symbol id, const string& filename);
+
+// Record that the module being translated imports the module filename,
+// which was already translated in this environment.
+void depend(const string& filename);
+
+}
+
+}
+
+#endif
@@ -38,6 +38,13 @@ OPCODE(popframe,'x')
 OPCODE(push_default,'x')
 OPCODE(jump_if_not_default,'o')
 
+// Superinstructions, each fusing an instruction with the one following it
+// (see program::fuse).  The parameter describes the first instruction.
+OPCODE(varfieldpush,'n')
+OPCODE(constbuiltin,'t')
+OPCODE(builtincjmp,'b')
+OPCODE(builtinnjmp,'b')
+
 #ifdef COMBO
 OPCODE(varpop,'n')
 OPCODE(fieldpop,'n')
@@ -8,6 +8,12 @@
  * three-dimensional algorithms in path3.cc.
  *****/
 
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
 #include "path.h"
 #include "util.h"
 #include "angle.h"
@@ -256,6 +262,143 @@ pair path::point(double t) const
   return abcd;
 }
 
+namespace {
+
+// Number of points evaluated per batch.
+const size_t batchSize=256;
+
+// Control points and times of a batch of cubic Bezier segments, stored
+// coordinate by coordinate so that they can be evaluated in SIMD lanes.
+struct bezierbatch {
+  double x[4][batchSize];
+  double y[4][batchSize];
+  double t[batchSize];
+  double X[batchSize];
+  double Y[batchSize];
+};
+
+// Evaluate each segment of the batch at its time by de Casteljau's
+// algorithm, with the same operations in the same order as path::point.
+inline void casteljau(double *A, const double *a, const double *b,
+                      const double *c, const double *d, const double *T,
+                      size_t m)
+{
+  for(size_t k=0; k < m; ++k) {
+    double t=T[k];
+    double one_t=1.0-t;
+    double ab=one_t*a[k]+t*b[k];
+    double bc=one_t*b[k]+t*c[k];
+    double cd=one_t*c[k]+t*d[k];
+    double abc=one_t*ab+t*bc;
+    double bcd=one_t*bc+t*cd;
+    A[k]=one_t*abc+t*bcd;
+  }
+}
+
+void evaluate(bezierbatch& B, size_t m)
+{
+  casteljau(B.X,B.x[0],B.x[1],B.x[2],B.x[3],B.t,m);
+  casteljau(B.Y,B.y[0],B.y[1],B.y[2],B.y[3],B.t,m);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_DISPATCH
+
+// AVX2 version of casteljau. Fused multiply-adds are deliberately avoided
+// so that the results are identical to those of the scalar code.
+__attribute__((target("avx2")))
+void casteljauAVX2(double *A, const double *a, const double *b,
+                   const double *c, const double *d, const double *T, size_t m)
+{
+  const __m256d one=_mm256_set1_pd(1.0);
+  size_t k=0;
+  for(; k+4 <= m; k += 4) {
+    __m256d t=_mm256_loadu_pd(T+k);
+    __m256d one_t=_mm256_sub_pd(one,t);
+    __m256d va=_mm256_loadu_pd(a+k);
+    __m256d vb=_mm256_loadu_pd(b+k);
+    __m256d vc=_mm256_loadu_pd(c+k);
+    __m256d vd=_mm256_loadu_pd(d+k);
+    __m256d ab=_mm256_add_pd(_mm256_mul_pd(one_t,va),_mm256_mul_pd(t,vb));
+    __m256d bc=_mm256_add_pd(_mm256_mul_pd(one_t,vb),_mm256_mul_pd(t,vc));
+    __m256d cd=_mm256_add_pd(_mm256_mul_pd(one_t,vc),_mm256_mul_pd(t,vd));
+    __m256d abc=_mm256_add_pd(_mm256_mul_pd(one_t,ab),_mm256_mul_pd(t,bc));
+    __m256d bcd=_mm256_add_pd(_mm256_mul_pd(one_t,bc),_mm256_mul_pd(t,cd));
+    _mm256_storeu_pd(A+k,_mm256_add_pd(_mm256_mul_pd(one_t,abc),
+                                       _mm256_mul_pd(t,bcd)));
+  }
+  casteljau(A+k,a+k,b+k,c+k,d+k,T+k,m-k);
+}
+
+__attribute__((target("avx2")))
+void evaluateAVX2(bezierbatch& B, size_t m)
+{
+  casteljauAVX2(B.X,B.x[0],B.x[1],B.x[2],B.x[3],B.t,m);
+  casteljauAVX2(B.Y,B.y[0],B.y[1],B.y[2],B.y[3],B.t,m);
+}
+#endif
+
+}
+
+void path::point(pair *z, const double *t, size_t count) const
+{
+  if(count == 0) return;
+  checkEmpty(n);
+
+#ifdef HAVE_AVX2_DISPATCH
+  static const bool avx2=__builtin_cpu_supports("avx2");
+#endif
+
+  bezierbatch B;
+  for(size_t start=0; start < count; start += batchSize) {
+    size_t m=std::min(batchSize,count-start);
+    for(size_t k=0; k < m; ++k) {
+      // Select the segment and local time as in point(double), reducing the
+      // clamped cases to a degenerate segment at the endpoint.
+      double s=t[start+k];
+      Int i=Floor(s);
+      Int iplus;
+      s=fmod(s,1);
+      if(s < 0) s += 1;
+
+      if(cycles) {
+        i=imod(i,n);
+        iplus=imod(i+1,n);
+      } else if(i < 0 || i >= n-1) {
+        pair z=nodes[i < 0 ? 0 : n-1].point;
+        for(size_t j=0; j < 4; ++j) {
+          B.x[j][k]=z.getx();
+          B.y[j][k]=z.gety();
+        }
+        B.t[k]=0.0;
+        continue;
+      } else
+        iplus=i+1;
+
+      const solvedKnot& left=nodes[i];
+      const solvedKnot& right=nodes[iplus];
+      B.x[0][k]=left.point.getx();
+      B.y[0][k]=left.point.gety();
+      B.x[1][k]=left.post.getx();
+      B.y[1][k]=left.post.gety();
+      B.x[2][k]=right.pre.getx();
+      B.y[2][k]=right.pre.gety();
+      B.x[3][k]=right.point.getx();
+      B.y[3][k]=right.point.gety();
+      B.t[k]=s;
+    }
+
+#ifdef HAVE_AVX2_DISPATCH
+    if(avx2) evaluateAVX2(B,m);
+    else
+#endif
+      evaluate(B,m);
+
+    for(size_t k=0; k < m; ++k)
+      z[start+k]=pair(B.X[k],B.Y[k]);
+  }
+}
+
 pair path::precontrol(double t) const
 {
   checkEmpty(n);
@@ -472,6 +615,30 @@ static inline void derivative(pair& a, pair& b, pair& c,
   c=c0-z0;
 }
 
+// Store in t the times in (0,1) at which the x and then the y coordinate of
+// the nonstraight segment i of g attain an extremum, returning their number.
+template<class P>
+static inline int extrema(const P& g, Int i, double *t)
+{
+  pair a,b,c;
+  derivative(a,b,c,g.point(i),g.postcontrol(i),g.precontrol(i+1),
+             g.point(i+1));
+
+  int n=0;
+  quadraticroots x(a.getx(),b.getx(),c.getx());
+  if(x.distinct != quadraticroots::NONE && goodroot(x.t1))
+    t[n++]=x.t1;
+  if(x.distinct == quadraticroots::TWO && goodroot(x.t2))
+    t[n++]=x.t2;
+
+  quadraticroots y(a.gety(),b.gety(),c.gety());
+  if(y.distinct != quadraticroots::NONE && goodroot(y.t1))
+    t[n++]=y.t1;
+  if(y.distinct == quadraticroots::TWO && goodroot(y.t2))
+    t[n++]=y.t2;
+  return n;
+}
+
 bbox path::bounds() const
 {
   if(!box.empty) return box;
@@ -489,26 +656,32 @@ bbox path::bounds() const
     addpoint(box,i);
     if(straight(i)) continue;
     
-    pair a,b,c;
-    derivative(a,b,c,point(i),postcontrol(i),precontrol(i+1),point(i+1));
-    
-    // Check x coordinate
-    quadraticroots x(a.getx(),b.getx(),c.getx());
-    if(x.distinct != quadraticroots::NONE && goodroot(x.t1))
-      addpoint(box,i+x.t1);
-    if(x.distinct == quadraticroots::TWO && goodroot(x.t2))
-      addpoint(box,i+x.t2);
-    
-    // Check y coordinate
-    quadraticroots y(a.gety(),b.gety(),c.gety());
-    if(y.distinct != quadraticroots::NONE && goodroot(y.t1))
-      addpoint(box,i+y.t1);
-    if(y.distinct == quadraticroots::TWO && goodroot(y.t2))
-      addpoint(box,i+y.t2);
+    double t[4];
+    for(int k=0, m=extrema(*this,i,t); k < m; ++k)
+      addpoint(box,i+t[k]);
   }
   return box;
 }
 
+bbox path::segmentbounds(Int i) const
+{
+  if(segmentboxes.empty()) {
+    Int len=length();
+    segmentboxes.resize(len);
+    for(Int j=0; j < len; ++j) {
+      bbox& box=segmentboxes[j];
+      box.add(point(j));
+      box.addnonempty(point(j+1));
+      if(straight(j)) continue;
+
+      double t[4];
+      for(int k=0, m=extrema(*this,j,t); k < m; ++k)
+        box.addnonempty(point(j+t[k]));
+    }
+  }
+  return segmentboxes[i];
+}
+
 bbox path::bounds(double min, double max) const
 {
   bbox box;
@@ -518,23 +691,9 @@ bbox path::bounds(double min, double max) const
     addpoint(box,i,min,max);
     if(straight(i)) continue;
     
-    pair a,b,c;
-    derivative(a,b,c,point(i),postcontrol(i),precontrol(i+1),point(i+1));
-    
-    // Check x coordinate
-    quadraticroots x(a.getx(),b.getx(),c.getx());
-    if(x.distinct != quadraticroots::NONE && goodroot(x.t1))
-      addpoint(box,i+x.t1,min,max);
-
-    if(x.distinct == quadraticroots::TWO && goodroot(x.t2))
-      addpoint(box,i+x.t2,min,max);
-    
-    // Check y coordinate
-    quadraticroots y(a.gety(),b.gety(),c.gety());
-    if(y.distinct != quadraticroots::NONE && goodroot(y.t1))
-      addpoint(box,i+y.t1,min,max);
-    if(y.distinct == quadraticroots::TWO && goodroot(y.t2))
-      addpoint(box,i+y.t2,min,max);
+    double t[4];
+    for(int k=0, m=extrema(*this,i,t); k < m; ++k)
+      addpoint(box,i+t[k],min,max);
   }
   addpoint(box,len,min,max);
   return box;
@@ -633,26 +792,36 @@ double path::cubiclength(Int i, double goal) const
 double path::arclength() const 
 {
   if (cached_length != -1) return cached_length;
+  if (empty()) return cached_length=0.0;
+  return arclength(length());
+}
 
-  double L=0.0;
-  for (Int i = 0; i < n-1; i++) {
-    L += cubiclength(i);
+double path::arclength(Int i) const
+{
+  if (arclengths.empty()) {
+    Int len=length();
+    arclengths.resize(len+1);
+    double L=0.0;
+    arclengths[0]=L;
+    for (Int j = 0; j < len; j++)
+      arclengths[j+1]=L += cubiclength(j);
+    cached_length = L;
   }
-  if(cycles) L += cubiclength(n-1);
-  cached_length = L;
-  return cached_length;
+  return arclengths[i];
 }
 
+// Locate the segment containing the goal by bisecting the cumulative
+// arclengths, then solve for the time within that segment.
 double path::arctime(double goal) const
 {
   if (cycles) {
-    if (goal == 0 || cached_length == 0) return 0;
+    if (goal == 0 || arclength() == 0) return 0;
     if (goal < 0)  {
       const path &rp = this->reverse();
       double result = -rp.arctime(-goal);
       return result;
     }
-    if (cached_length > 0 && goal >= cached_length) {
+    if (goal >= cached_length) {
       Int loops = (Int)(goal / cached_length);
       goal -= loops*cached_length;
       return loops*n+arctime(goal);
@@ -660,39 +829,15 @@ double path::arctime(double goal) const
   } else {
     if (goal <= 0)
       return 0;
-    if (cached_length > 0 && goal >= cached_length)
+    if (goal >= arclength())
       return n-1;
   }
-    
-  double l,L=0;
-  for (Int i = 0; i < n-1; i++) {
-    l = cubiclength(i,goal);
-    if (l < 0)
-      return (-l+i);
-    else {
-      L += l;
-      goal -= l;
-      if (goal <= 0)
-        return i+1;
-    }
-  }
-  if (cycles) {
-    l = cubiclength(n-1,goal);
-    if (l < 0)
-      return -l+n-1;
-    if (cached_length > 0 && cached_length != L+l) {
-      reportError("arclength != length.\n"
-                  "path::arclength(double) must have broken semantics.\n"
-                  "Please report this error.");
-    }
-    cached_length = L += l;
-    goal -= l;
-    return arctime(goal)+n;
-  }
-  else {
-    cached_length = L;
-    return length();
-  }
+
+  arclength(0);
+  Int i=std::lower_bound(arclengths.begin()+1,arclengths.end(),goal)-
+    arclengths.begin()-1;
+  double l=cubiclength(i,goal-arclengths[i]);
+  return l < 0 ? i-l : i+1;
 }
 
 // }}}
@@ -779,8 +924,169 @@ void roots(std::vector<double> &r, double x0, double c0, double c1, double x1,
   roots(r,a,b,c,d);
 }
 
+// A subpath used by intersections: either a range of the nodes of an existing
+// path or a single subdivided segment held by value, so that the recursive
+// subdivision allocates no new paths. The member functions reproduce the
+// arithmetic of the path member functions of the same name.
+class pathview {
+  const solvedKnot *base; // Nodes of the original path, or NULL.
+  Int N;                  // Number of nodes of the original path.
+  bool basecycles;
+  Int offset;             // Index in the original path of node 0.
+  solvedKnot segment[2];  // Nodes of a subdivided segment.
+  Int n;
+  bool cycles;
+  bool trimmed;           // Whether the ends are clamped, as by path::subpath.
+
+  const solvedKnot& node(Int i) const {
+    if(!base) return segment[i];
+    Int j=offset+i;
+    return base[basecycles ? imod(j,N) : j];
+  }
+
+  pair pre(Int i) const {
+    return trimmed && i == 0 ? node(i).point : node(i).pre;
+  }
+
+  pair post(Int i) const {
+    return trimmed && i == n-1 ? node(i).point : node(i).post;
+  }
+
+public:
+  pathview()
+    : base(NULL), N(0), basecycles(false), offset(0), n(0), cycles(false),
+      trimmed(false) {}
+
+  pathview(path& p)
+    : base(p.Nodes().data()), N(p.size()), basecycles(p.cyclic()), offset(0),
+      n(p.size()), cycles(p.cyclic()), trimmed(false) {}
+
+  // A segment, clamped as by the path constructor.
+  pathview(const solvedKnot& n1, const solvedKnot& n2)
+    : base(NULL), N(0), basecycles(false), offset(0), n(2), cycles(false),
+      trimmed(true)
+  {
+    segment[0]=n1;
+    segment[1]=n2;
+    segment[0].pre=segment[0].point;
+    segment[1].post=segment[1].point;
+  }
+
+  friend bool operator== (const pathview& p, const pathview& q)
+  {
+    if(p.cycles != q.cycles || p.n != q.n) return false;
+    for(Int i=0; i < p.n; ++i)
+      if(p.pre(i) != q.pre(i) || p.node(i).point != q.node(i).point ||
+         p.post(i) != q.post(i)) return false;
+    return true;
+  }
+
+  Int length() const {
+    return cycles ? n : n-1;
+  }
+
+  bool cyclic() const {
+    return cycles;
+  }
+
+  bool straight(Int t) const {
+    if(cycles) return node(imod(t,n)).straight;
+    return (t >= 0 && t < n) ? node(t).straight : false;
+  }
+
+  pair point(Int t) const {
+    return node(adjustedIndex(t,n,cycles)).point;
+  }
+
+  pair precontrol(Int t) const {
+    return pre(adjustedIndex(t,n,cycles));
+  }
+
+  pair postcontrol(Int t) const {
+    return post(adjustedIndex(t,n,cycles));
+  }
+
+  pair point(double t) const
+  {
+    checkEmpty(n);
+
+    Int i=Floor(t);
+    Int iplus;
+    t=fmod(t,1);
+    if(t < 0) t += 1;
+
+    if(cycles) {
+      i=imod(i,n);
+      iplus=imod(i+1,n);
+    }
+    else if(i < 0)
+      return node(0).point;
+    else if(i >= n-1)
+      return node(n-1).point;
+    else
+      iplus=i+1;
+
+    double one_t=1.0-t;
+
+    pair a=node(i).point,
+      b=post(i),
+      c=pre(iplus),
+      d=node(iplus).point,
+      ab=one_t*a+t*b,
+      bc=one_t*b+t*c,
+      cd=one_t*c+t*d,
+      abc=one_t*ab+t*bc,
+      bcd=one_t*bc+t*cd,
+      abcd=one_t*abc+t*bcd;
+
+    return abcd;
+  }
+
+  // The subpath from node a to node b, where 0 <= a < b <= length().
+  pathview subpath(Int a, Int b) const
+  {
+    pathview v(*this);
+    if(base) {
+      v.offset=offset+a;
+      v.n=b-a+1;
+    }
+    v.cycles=false;
+    v.trimmed=true;
+    return v;
+  }
+
+  void halve(pathview& first, pathview& second) const
+  {
+    solvedKnot sn[3];
+    splitCubic(sn,0.5,node(0),node(adjustedIndex(1,n,cycles)));
+    first=pathview(sn[0],sn[1]);
+    second=pathview(sn[1],sn[2]);
+  }
+
+  // Compute the bounding box as by path::bounds.
+  void extent(pair& min, pair& max) const
+  {
+    checkEmpty(n);
+    bbox box;
+    Int len=length();
+    box.add(point(len));
+
+    for(Int i=0; i < len; i++) {
+      box.addnonempty(point(i));
+      if(straight(i)) continue;
+
+      double t[4];
+      for(int k=0, m=extrema(*this,i,t); k < m; ++k)
+        box.addnonempty(point(i+t[k]));
+    }
+    min=box.Min();
+    max=box.Max();
+  }
+};
+
 // Return all intersection times of path g with the pair z.
-void intersections(std::vector<double>& T, const path& g, const pair& z,
+template<class P>
+void intersections(std::vector<double>& T, const P& g, const pair& z,
                    double fuzz)
 {
   double fuzz2=fuzz*fuzz;
@@ -819,7 +1125,8 @@ inline bool online(const pair&p, const pair& q, const pair& z, double fuzz)
 // line through p and q; if there are an infinite number of intersection points,
 // the returned list is guaranteed to include the endpoint times of
 // the intersection if endpoints=true.
-void lineintersections(std::vector<double>& T, const path& g,
+template<class P>
+void lineintersections(std::vector<double>& T, const P& g,
                        const pair& p, const pair& q, double fuzz,
                        bool endpoints=false)
 {
@@ -850,7 +1157,7 @@ void lineintersections(std::vector<double>& T, const path& g,
       roots(r,a,b,c,d);
     else r.push_back(0.0);
     if(endpoints) {
-      path h=g.subpath(i,i+1);
+      P h=g.subpath(i,i+1);
       intersections(r,h,p,fuzz);
       intersections(r,h,q,fuzz);
       if(online(p,q,z0,fuzz)) r.push_back(0.0);
@@ -871,8 +1178,9 @@ void lineintersections(std::vector<double>& T, const path& g,
 // An optimized implementation of intersections(g,p--q);
 // if there are an infinite number of intersection points, the returned list is
 // only guaranteed to include the endpoint times of the intersection.
+template<class P>
 void intersections(std::vector<double>& S, std::vector<double>& T,
-                   const path& g, const pair& p, const pair& q, double fuzz)
+                   const P& g, const pair& p, const pair& q, double fuzz)
 {
   double length2=(q-p).abs2();
   if(length2 == 0.0) {
@@ -909,7 +1217,7 @@ void add(std::vector<double>& S, double s, const path& p, double fuzz2)
 }
   
 void add(std::vector<double>& S, std::vector<double>& T, double s, double t,
-         const path& p, double fuzz2)
+         const pathview& p, double fuzz2)
 {
   pair z=p.point(s);
   size_t n=S.size();
@@ -922,7 +1230,7 @@ void add(std::vector<double>& S, std::vector<double>& T, double s, double t,
 void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
          std::vector<double>& S1, std::vector<double>& T1,
          double pscale, double qscale, double poffset, double qoffset,
-         const path& p, double fuzz2, bool single)
+         const pathview& p, double fuzz2, bool single)
 {
   if(single) {
     s=s*pscale+poffset;
@@ -936,7 +1244,7 @@ void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
 
 void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
          std::vector<double>& S1, std::vector<double>& T1,
-         const path& p, double fuzz2, bool single)
+         const pathview& p, double fuzz2, bool single)
 {
   size_t n=S1.size();
   if(single) {
@@ -963,8 +1271,9 @@ void intersections(std::vector<double>& S, path& g,
 }
 
 bool intersections(double &s, double &t, std::vector<double>& S,
-                   std::vector<double>& T, path& p, path& q,
-                   double fuzz, bool single, bool exact, unsigned depth)
+                   std::vector<double>& T, const pathview& p,
+                   const pathview& q, double fuzz, bool single, bool exact,
+                   unsigned depth)
 {
   if(errorstream::interrupt) throw interrupted();
   
@@ -987,10 +1296,9 @@ bool intersections(double &s, double &t, std::vector<double>& S,
     return S1.size() > 0;
   }
   
-  pair maxp=p.max();
-  pair minp=p.min();
-  pair maxq=q.max();
-  pair minq=q.min();
+  pair minp,maxp,minq,maxq;
+  p.extent(minp,maxp);
+  q.extent(minq,maxq);
   
   if(maxp.getx()+fuzz >= minq.getx() &&
      maxp.gety()+fuzz >= minq.gety() && 
@@ -1010,7 +1318,7 @@ bool intersections(double &s, double &t, std::vector<double>& S,
       return true;
     }
     
-    path p1,p2;
+    pathview p1,p2;
     double pscale,poffset;
     std::vector<double> S1,T1;
     
@@ -1030,7 +1338,7 @@ bool intersections(double &s, double &t, std::vector<double>& S,
       pscale=1.0;
     }
       
-    path q1,q2;
+    pathview q1,q2;
     double qscale,qoffset;
     
     if(lq <= 1) {
@@ -1097,6 +1405,275 @@ bool intersections(double &s, double &t, std::vector<double>& S,
   return false;
 }
 
+bool intersections(double &s, double &t, std::vector<double>& S,
+                   std::vector<double>& T, path& p, path& q,
+                   double fuzz, bool single, bool exact, unsigned depth)
+{
+  return intersections(s,t,S,T,pathview(p),pathview(q),fuzz,single,exact,
+                       depth);
+}
+
+namespace {
+
+struct timeorder {
+  const std::vector<double>& S;
+  const std::vector<double>& T;
+  timeorder(const std::vector<double>& S, const std::vector<double>& T) :
+    S(S), T(T) {}
+
+  bool operator() (size_t a, size_t b) const {
+    if(S[a] < S[b]) return true;
+    if(S[a] > S[b]) return false;
+    return T[a] < T[b];
+  }
+};
+
+}
+
+void sortedintersections(std::vector<double>& S, std::vector<double>& T,
+                         path& p, path& q, double fuzz)
+{
+  bool exact=fuzz <= 0.0;
+  if(fuzz < 0.0)
+    fuzz=BigFuzz*max(max(length(p.max()),length(p.min())),
+                     max(length(q.max()),length(q.min())));
+  double s,t;
+  std::vector<double> S1,T1;
+  intersections(s,t,S1,T1,p,q,fuzz,false,true);
+  size_t n=S1.size();
+  if(n == 0 && !exact) {
+    if(intersections(s,t,S1,T1,p,q,fuzz,true,false)) {
+      S.push_back(s);
+      T.push_back(t);
+    }
+    return;
+  }
+  std::vector<size_t> order(n);
+  for(size_t i=0; i < n; ++i)
+    order[i]=i;
+  std::stable_sort(order.begin(),order.end(),timeorder(S1,T1));
+  for(size_t i=0; i < n; ++i) {
+    S.push_back(S1[order[i]]);
+    T.push_back(T1[order[i]]);
+  }
+}
+
+namespace {
+
+typedef std::pair<size_t,size_t> indexpair;
+
+inline bool overlapping(const bbox& a, const bbox& b)
+{
+  return a.right >= b.left && b.right >= a.left && a.top >= b.bottom &&
+    b.top >= a.bottom;
+}
+
+// A bounding-volume hierarchy of the segments of a set of paths, used to find
+// the pairs of paths that may intersect.
+class segmenthierarchy {
+  struct segment {
+    bbox box;    // Bounding box of the segment, enlarged by the margin.
+    pair center;
+    size_t path;
+  };
+
+  // A leaf node holds the segments [start,end); the root is never a child.
+  struct node {
+    bbox box;
+    size_t left,right;
+    size_t start,end;
+  };
+
+  static const size_t leafsize=4;
+
+  std::vector<segment> segments;
+  std::vector<node> nodes;
+
+  struct centerorder {
+    bool x;
+    centerorder(bool x) : x(x) {}
+    bool operator() (const segment& a, const segment& b) const {
+      return x ? a.center.getx() < b.center.getx() :
+        a.center.gety() < b.center.gety();
+    }
+  };
+
+  void add(const bbox& b, size_t index, double margin) {
+    segment s;
+    s.box=bbox(b.left-margin,b.bottom-margin,b.right+margin,b.top+margin);
+    s.center=0.5*(b.Min()+b.Max());
+    s.path=index;
+    segments.push_back(s);
+  }
+
+  size_t build(size_t start, size_t end) {
+    size_t index=nodes.size();
+    nodes.push_back(node());
+    bbox box,centers;
+    for(size_t i=start; i < end; ++i) {
+      box += segments[i].box;
+      centers += segments[i].center;
+    }
+    nodes[index].box=box;
+    nodes[index].start=start;
+    nodes[index].end=end;
+    nodes[index].left=nodes[index].right=0;
+    if(end-start <= leafsize) return index;
+
+    size_t mid=(start+end)/2;
+    bool x=centers.right-centers.left >= centers.top-centers.bottom;
+    std::nth_element(segments.begin()+start,segments.begin()+mid,
+                     segments.begin()+end,centerorder(x));
+    size_t left=build(start,mid);
+    size_t right=build(mid,end);
+    nodes[index].left=left;
+    nodes[index].right=right;
+    return index;
+  }
+
+  void overlaps(std::vector<indexpair>& pairs, size_t a, size_t b) const {
+    const node& A=nodes[a];
+    const node& B=nodes[b];
+    if(a != b && !overlapping(A.box,B.box)) return;
+    bool leafA=A.left == 0;
+    bool leafB=B.left == 0;
+    if(leafA && leafB) {
+      for(size_t i=A.start; i < A.end; ++i) {
+        const segment& u=segments[i];
+        for(size_t j=a == b ? i+1 : B.start; j < B.end; ++j) {
+          const segment& v=segments[j];
+          if(u.path != v.path && overlapping(u.box,v.box))
+            pairs.push_back(u.path < v.path ? indexpair(u.path,v.path) :
+                            indexpair(v.path,u.path));
+        }
+      }
+    } else if(a == b) {
+      overlaps(pairs,A.left,A.left);
+      overlaps(pairs,A.right,A.right);
+      overlaps(pairs,A.left,A.right);
+    } else if(leafB || (!leafA && A.end-A.start >= B.end-B.start)) {
+      overlaps(pairs,A.left,b);
+      overlaps(pairs,A.right,b);
+    } else {
+      overlaps(pairs,a,B.left);
+      overlaps(pairs,a,B.right);
+    }
+  }
+
+public:
+  // Add the segments of path p, which has the given index.
+  void add(const path& p, size_t index, double margin) {
+    Int len=p.length();
+    if(len == 0) {
+      bbox b;
+      b += p.point((Int) 0);
+      add(b,index,margin);
+    }
+    for(Int i=0; i < len; ++i)
+      add(p.segmentbounds(i),index,margin);
+  }
+
+  // Return the distinct pairs of paths with overlapping segments.
+  void overlaps(std::vector<indexpair>& pairs) {
+    if(segments.empty()) return;
+    build(0,segments.size());
+    overlaps(pairs,0,0);
+    std::sort(pairs.begin(),pairs.end());
+    pairs.erase(std::unique(pairs.begin(),pairs.end()),pairs.end());
+  }
+};
+
+// Intersect the candidate pairs [start,end).
+struct pairtask {
+  const std::vector<path *> *g;
+  const std::vector<indexpair> *pairs;
+  size_t start,end;
+  double fuzz;
+  std::vector<crossing> C;
+  bool stopped;
+
+  void run() {
+    for(size_t k=start; k < end; ++k) {
+      size_t i=(*pairs)[k].first;
+      size_t j=(*pairs)[k].second;
+      std::vector<double> S,T;
+      sortedintersections(S,T,*(*g)[i],*(*g)[j],fuzz);
+      for(size_t m=0; m < S.size(); ++m) {
+        crossing c={i,j,S[m],T[m]};
+        C.push_back(c);
+      }
+    }
+  }
+};
+
+#ifdef HAVE_PTHREAD
+void *runpairtask(void *task)
+{
+  pairtask *t=(pairtask *) task;
+  try {
+    t->run();
+  } catch(interrupted&) {
+    t->stopped=true;
+  }
+  return NULL;
+}
+#endif
+
+// Minimum number of candidate pairs for each additional thread.
+const size_t pairsPerThread=64;
+
+}
+
+void intersections(std::vector<crossing>& C, const std::vector<path *>& g,
+                   double fuzz, unsigned int threads)
+{
+  // Computing the bounds here also caches them in each path before any
+  // threads read them.
+  segmenthierarchy h;
+  for(size_t i=0; i < g.size(); ++i) {
+    const path& p=*g[i];
+    double r=max(length(p.max()),length(p.min()));
+    double margin=(fuzz < 0.0 ? BigFuzz*r : 0.5*fuzz)+BigFuzz*r;
+    h.add(p,i,margin);
+  }
+
+  std::vector<indexpair> pairs;
+  h.overlaps(pairs);
+
+  size_t n=pairs.size();
+  size_t count=min((size_t) max(threads,1U),max(n/pairsPerThread,(size_t) 1));
+  std::vector<pairtask> tasks(count);
+  for(size_t k=0; k < count; ++k) {
+    pairtask& t=tasks[k];
+    t.g=&g;
+    t.pairs=&pairs;
+    t.start=n*k/count;
+    t.end=n*(k+1)/count;
+    t.fuzz=fuzz;
+    t.stopped=false;
+  }
+
+#ifdef HAVE_PTHREAD
+  std::vector<pthread_t> thread(count);
+  std::vector<bool> started(count,false);
+  for(size_t k=1; k < count; ++k)
+    started[k]=pthread_create(&thread[k],NULL,runpairtask,&tasks[k]) == 0;
+  runpairtask(&tasks[0]);
+  for(size_t k=1; k < count; ++k) {
+    if(started[k]) pthread_join(thread[k],NULL);
+    else runpairtask(&tasks[k]);
+  }
+#else
+  for(size_t k=0; k < count; ++k)
+    tasks[k].run();
+#endif
+
+  for(size_t k=0; k < count; ++k) {
+    if(tasks[k].stopped) throw interrupted();
+    C.insert(C.end(),tasks[k].C.begin(),tasks[k].C.end());
+  }
+}
+
 // }}}
 
 ostream& operator<< (ostream& out, const path& p)
@@ -1254,30 +1831,248 @@ bool checkcurve(const pair& z0, const pair& c0, const pair& c1,
   return false;
 }
 
+namespace {
+
+// Return the winding number of the cyclic path g relative to z, where b is
+// the bounding box of g.
+Int windingnumber(const path& g, const bbox& b, const pair& z)
+{
+  static const Int undefined=Int_MAX % 2 ? Int_MAX : Int_MAX-1;
+  
+  if(z.getx() < b.left || z.getx() > b.right ||
+     z.gety() < b.bottom || z.gety() > b.top) return 0;
+  
+  Int count=0;
+  Int n=g.length();
+  for(Int i=0; i < n; ++i)
+    if(windingsegment(g,i,z,count)) return undefined;
+  return count;
+}
+
+// Segments spanning more than this many columns are listed once per band
+// rather than once per cell.
+const Int wideColumns=8;
+
+struct gridsegment {
+  double xmin,xmax,ymin,ymax;
+  Int b0,b1;  // Bands of the hull.
+  Int c0,c1;  // Columns of the hull.
+  Int lo,hi;  // Bands of the lower and upper endpoints.
+};
+
+// A change of the contribution of a segment to the right of a point within
+// a band as the point rises through height y.
+struct gridevent {
+  Int c0;
+  double y;
+  Int weight;
+  bool operator < (const gridevent& e) const {return c0 > e.c0;}
+};
+
+}
+
 // Return the winding number of the region bounded by the (cyclic) path
 // relative to the point z, or the largest odd integer if the point lies on
 // the path.
 Int path::windingnumber(const pair& z) const
 {
-  static const Int undefined=Int_MAX % 2 ? Int_MAX : Int_MAX-1;
+  if(!cycles)
+    reportError("path is not cyclic");
   
+  return camp::windingnumber(*this,bounds(),z);
+}
+
+void path::windingnumber(Int *count, const pair *z, size_t m) const
+{
+  if(m == 0) return;
   if(!cycles)
     reportError("path is not cyclic");
   
   bbox b=bounds();
-  
-  if(z.getx() < b.left || z.getx() > b.right ||
-     z.gety() < b.bottom || z.gety() > b.top) return 0;
-  
-  Int count=0;
-  for(Int i=0; i < n; ++i)
-    if(straight(i)) {
-      if(checkstraight(point(i),point(i+1),z,count))
-        return undefined;
-    } else
-      if(checkcurve(point(i),postcontrol(i),precontrol(i+1),point(i+1),z,count,
-                    maxdepth)) return undefined;
-  return count;
+  for(size_t k=0; k < m; ++k)
+    count[k] += camp::windingnumber(*this,b,z[k]);
+}
+
+bool windingsegment(const path& g, Int i, const pair& z, Int& count)
+{
+  if(g.straight(i))
+    return checkstraight(g.point(i),g.point(i+1),z,count);
+  return checkcurve(g.point(i),g.postcontrol(i),g.precontrol(i+1),
+                    g.point(i+1),z,count,maxdepth);
+}
+
+// The bounds array holds the origin and inverse cell size of the grid in
+// x and y, the bounds of each path, the hull (left, right) and endpoint
+// heights of each segment, and the height of each event. The index array
+// holds the numbers of bands B, columns C, paths, segments, and events,
+// followed by
+//  - the offset into the index array of the list of segments overlapping
+//    each cell, and of the end of the last list;
+//  - the offset of the list of segments in each band that span more than
+//    wideColumns columns, and of the end of the last list;
+//  - the first event of each band, and the end of the last band;
+//  - for each cell, the sum of the contributions of the segments crossing
+//    its band that lie entirely in columns to its right;
+//  - the path and segment numbers of each segment;
+//  - the first column and weight of each event;
+//  - the lists of segments.
+//
+// A segment entirely to the right of a point contributes a step depending
+// only on the heights of its endpoints, and one entirely to the left
+// contributes nothing, so only the segments in the cell of a point need to
+// be examined. The step of a segment with an endpoint in a band is recorded
+// as an event at the height of the endpoint; events are ordered by
+// decreasing first column.
+void regionindex(std::vector<double>& bounds, std::vector<Int>& index,
+                 const std::vector<const path *>& g)
+{
+  using namespace regiongrid;
+  size_t n=g.size();
+
+  std::vector<std::pair<Int,Int> > numbers;
+  std::vector<gridsegment> segments;
+  std::vector<double> paths(4*n);
+  bbox box;
+  for(size_t p=0; p < n; ++p) {
+    const path& P=*g[p];
+    if(!P.cyclic())
+      reportError("path is not cyclic");
+    bbox b=P.bounds();
+    paths[4*p]=b.left; paths[4*p+1]=b.bottom;
+    paths[4*p+2]=b.right; paths[4*p+3]=b.top;
+    Int L=P.length();
+    for(Int i=0; i < L; ++i) {
+      bbox h(P.point(i));
+      h.addnonempty(P.point(i+1));
+      if(!P.straight(i)) {
+        h.addnonempty(P.postcontrol(i));
+        h.addnonempty(P.precontrol(i+1));
+      }
+      gridsegment s;
+      s.xmin=h.left; s.xmax=h.right;
+      s.ymin=h.bottom; s.ymax=h.top;
+      box += h;
+      numbers.push_back(std::make_pair((Int) p,i));
+      segments.push_back(s);
+    }
+  }
+
+  Int S=segments.size();
+  double r=sqrt((double) S);
+  Int B=max(min((Int) ceil(2.0*r),(Int) 4096),(Int) 1);
+  Int C=max(min((Int) ceil(r),(Int) 2048),(Int) 1);
+  double x0=box.empty ? 0.0 : box.left;
+  double y0=box.empty ? 0.0 : box.bottom;
+  double invw=box.right > box.left ? C/(box.right-box.left) : 0.0;
+  double invh=box.top > box.bottom ? B/(box.top-box.bottom) : 0.0;
+
+  size_t cellcount=B*C;
+  std::vector<Int> cellsize(cellcount), widesize(B);
+  std::vector<Int> delta(cellcount);
+  std::vector<std::vector<gridevent> > events(B);
+
+  for(Int k=0; k < S; ++k) {
+    gridsegment& s=segments[k];
+    const path& P=*g[numbers[k].first];
+    Int i=numbers[k].second;
+    double z0=P.point(i).gety(), z1=P.point(i+1).gety();
+    s.lo=cell(min(z0,z1),y0,invh,B);
+    s.hi=cell(max(z0,z1),y0,invh,B);
+    s.b0=cell(s.ymin,y0,invh,B);
+    s.b1=cell(s.ymax,y0,invh,B);
+    s.c0=cell(s.xmin,x0,invw,C);
+    s.c1=cell(s.xmax,x0,invw,C);
+    for(Int b=s.b0; b <= s.b1; ++b) {
+      if(s.c1-s.c0 > wideColumns) ++widesize[b];
+      else
+        for(Int c=s.c0; c <= s.c1; ++c)
+          ++cellsize[b*C+c];
+    }
+    if(z0 == z1) continue;
+    // To the right of a point at height y, the segment contributes
+    // sign*([lo <= y]-[hi <= y]).
+    Int sign=z0 < z1 ? 1 : -1;
+    for(Int b=s.lo+1; b < s.hi; ++b)
+      delta[b*C+s.c0] += sign;
+    gridevent e={s.c0,min(z0,z1),sign};
+    events[s.lo].push_back(e);
+    e.y=max(z0,z1);
+    e.weight=-sign;
+    if(s.hi == s.lo) events[s.lo].push_back(e);
+    else {
+      events[s.hi].push_back(e);
+      delta[s.hi*C+s.c0] += sign;
+    }
+  }
+
+  Int E=0;
+  for(Int b=0; b < B; ++b)
+    E += events[b].size();
+
+  layout L(B,C,n,S,E);
+  index.resize(L.entries());
+  index[0]=B; index[1]=C; index[2]=n; index[3]=S; index[4]=E;
+
+  bounds.resize(L.size());
+  bounds[X0]=x0; bounds[INVW]=invw;
+  bounds[Y0]=y0; bounds[INVH]=invh;
+  std::copy(paths.begin(),paths.end(),bounds.begin()+L.paths());
+
+  Int end=L.entries();
+  for(size_t k=0; k < cellcount; ++k) {
+    index[L.cells()+k]=end;
+    end += cellsize[k];
+  }
+  index[L.cells()+cellcount]=end;
+  for(Int b=0; b < B; ++b) {
+    index[L.wide()+b]=end;
+    end += widesize[b];
+  }
+  index[L.wide()+B]=end;
+  index.resize(end);
+
+  for(Int b=0; b < B; ++b) {
+    Int sum=0;
+    for(Int c=C-1; c >= 0; --c) {
+      index[L.suffix()+b*C+c]=sum;
+      sum += delta[b*C+c];
+    }
+  }
+
+  // Fill the lists, keeping the next free entry of each in its offset.
+  std::vector<Int> next(index.begin()+L.cells(),index.begin()+L.events());
+  std::vector<Int>::iterator nextwide=next.begin()+cellcount+1;
+  for(Int k=0; k < S; ++k) {
+    const gridsegment& s=segments[k];
+    index[L.segments()+2*k]=numbers[k].first;
+    index[L.segments()+2*k+1]=numbers[k].second;
+    size_t h=L.hulls()+4*k;
+    const path& P=*g[numbers[k].first];
+    bounds[h]=s.xmin;
+    bounds[h+1]=s.xmax;
+    bounds[h+2]=P.point(numbers[k].second).gety();
+    bounds[h+3]=P.point(numbers[k].second+1).gety();
+    for(Int b=s.b0; b <= s.b1; ++b) {
+      if(s.c1-s.c0 > wideColumns)
+        index[nextwide[b]++]=k;
+      else
+        for(Int c=s.c0; c <= s.c1; ++c)
+          index[next[b*C+c]++]=k;
+    }
+  }
+
+  Int e=0;
+  for(Int b=0; b < B; ++b) {
+    index[L.events()+b]=e;
+    std::vector<gridevent>& v=events[b];
+    std::stable_sort(v.begin(),v.end());
+    for(size_t j=0; j < v.size(); ++j, ++e) {
+      index[L.eventdata()+2*e]=v[j].c0;
+      index[L.eventdata()+2*e+1]=v[j].weight;
+      bounds[L.heights()+e]=v[j].y;
+    }
+  }
+  index[L.events()+B]=e;
 }
 
 path path::transformed(const transform& t) const
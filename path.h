@@ -81,6 +81,8 @@ class path : public gc {
 
   mem::vector<solvedKnot> nodes;
   mutable double cached_length; // Cache length since path is immutable.
+  mutable mem::vector<double> arclengths; // Arclength to each node.
+  mutable mem::vector<bbox> segmentboxes;   // Bounds of each segment.
   
   mutable bbox box;
   mutable bbox times; // Times where minimum and maximum extents are attained.
@@ -123,7 +125,7 @@ public:
   // Copy constructor
   path(const path& p)
     : cycles(p.cycles), n(p.n), nodes(p.nodes), cached_length(p.cached_length),
-      box(p.box)
+      arclengths(p.arclengths), segmentboxes(p.segmentboxes), box(p.box)
   {}
 
   path unstraighten() const
@@ -183,6 +185,9 @@ public:
   }
 
   pair point(double t) const;
+
+  // Evaluate point(t[k]) into z[k] for k < count.
+  void point(pair *z, const double *t, size_t count) const;
   
   pair precontrol(Int t) const
   {
@@ -317,6 +322,9 @@ public:
   
   // Used by picture to determine bounding box.
   bbox bounds() const;
+
+  // Return the bounding box of segment i, where 0 <= i < length().
+  bbox segmentbounds(Int i) const;
   
   pair mintimes() const {
     checkEmpty(n);
@@ -352,6 +360,8 @@ public:
   
   double cubiclength(Int i, double goal=-1) const;
   double arclength () const;
+  // Return the arclength from node 0 to node i, where 0 <= i <= length().
+  double arclength(Int i) const;
   double arctime (double l) const;
   double directiontime(const pair& z) const;
  
@@ -379,6 +389,9 @@ public:
 // relative to the point z.
   Int windingnumber(const pair& z) const;
 
+// Add the winding number relative to z[k] to count[k] for k < m.
+  void windingnumber(Int *count, const pair *z, size_t m) const;
+
   // Transformation
   path transformed(const transform& t) const;
   
@@ -398,6 +411,144 @@ bool intersections(double& s, double& t, std::vector<double>& S,
 void intersections(std::vector<double>& S, path& g,
                    const pair& p, const pair& q, double fuzz);
 
+// Return in S and T the intersection times of p and q, sorted by S and then
+// T, as returned by the intersections(path,path) builtin; a negative fuzz
+// requests the default.
+void sortedintersections(std::vector<double>& S, std::vector<double>& T,
+                         path& p, path& q, double fuzz);
+
+// An intersection of paths i and j at times s and t.
+struct crossing {
+  size_t i,j;
+  double s,t;
+};
+
+// Return the intersections of every pair of paths g[i] and g[j] with i < j,
+// ordered by i, j, and then as by sortedintersections. Candidate pairs are
+// found from a bounding-volume hierarchy of the segments of all of the paths
+// and are intersected on the given number of threads.
+void intersections(std::vector<crossing>& C, const std::vector<path *>& g,
+                   double fuzz, unsigned int threads=1);
+
+// Add the contribution of segment i of the cyclic path g to its winding
+// number relative to z to count, as in path::windingnumber; return true if z
+// lies on the segment.
+bool windingsegment(const path& g, Int i, const pair& z, Int& count);
+
+// Build in bounds and index a uniform grid over the segments of the cyclic
+// paths g for regionwindingnumber. Both arrays are flat so that they can be
+// stored in Asymptote arrays; their layout is described in path.cc.
+void regionindex(std::vector<double>& bounds, std::vector<Int>& index,
+                 const std::vector<const path *>& g);
+
+namespace regiongrid {
+
+// The offsets of the sections of the arrays built by regionindex, for B
+// bands, C columns, n paths, S segments, and E events.
+struct layout {
+  Int B,C,n,S,E;
+
+  layout(Int B, Int C, Int n, Int S, Int E) : B(B), C(C), n(n), S(S), E(E) {}
+  template<class Ints>
+  layout(const Ints& index) : B(index[0]), C(index[1]), n(index[2]),
+                              S(index[3]), E(index[4]) {}
+
+  // Index array.
+  size_t cells() const {return 5;}
+  size_t wide() const {return cells()+B*C+1;}
+  size_t events() const {return wide()+B+1;}
+  size_t suffix() const {return events()+B+1;}
+  size_t segments() const {return suffix()+B*C;}
+  size_t eventdata() const {return segments()+2*S;}
+  size_t entries() const {return eventdata()+2*E;}
+
+  // Bounds array.
+  size_t paths() const {return 4;}
+  size_t hulls() const {return paths()+4*n;}
+  size_t heights() const {return hulls()+4*S;}
+  size_t size() const {return heights()+E;}
+};
+
+enum {X0, INVW, Y0, INVH};
+
+inline Int cell(double x, double x0, double inv, Int n)
+{
+  double v=floor((x-x0)*inv);
+  return v > 0 ? (v < n ? (Int) v : n-1) : 0;
+}
+
+// The winding number contribution of a segment from z0 to z1 that lies
+// strictly to the right of a point at height y.
+inline Int step(double y0, double y1, double y)
+{
+  if(y0 <= y && y < y1) return 1;
+  if(y1 <= y && y < y0) return -1;
+  return 0;
+}
+
+// Add the contribution of segment s to count, given that the columns of its
+// hull include that of z. Return true if z lies on its path.
+template<class Paths, class Reals, class Ints>
+bool addsegment(const Paths& g, const Reals& bounds, const Ints& index,
+                const layout& L, Int s, const pair& z, Int& count)
+{
+  size_t h=L.hulls()+4*s;
+  double xmin=bounds[h], xmax=bounds[h+1];
+  double x=z.getx(), y=z.gety();
+  if(xmax < x) return false;
+  if(xmin > x) {
+    count += step(bounds[h+2],bounds[h+3],y);
+    return false;
+  }
+  Int p=index[L.segments()+2*s];
+  size_t k=L.paths()+4*p;
+  double left=bounds[k], bottom=bounds[k+1];
+  double right=bounds[k+2], top=bounds[k+3];
+  // Outside of the bounds of its path, where path::windingnumber returns
+  // zero, the contributions of all of the segments of a path must cancel.
+  if(x < left || x > right || y < bottom || y > top) {
+    if(x < left) count += step(bounds[h+2],bounds[h+3],y);
+    return false;
+  }
+  return windingsegment(g[p],index[L.segments()+2*s+1],z,count);
+}
+
+}
+
+// Compute in count the sum of the winding numbers of the paths g relative
+// to z, using the index built by regionindex. Return false if z lies on one
+// of the paths, in which case count is undefined.
+template<class Paths, class Reals, class Ints>
+bool regionwindingnumber(Int& count, const Paths& g, const Reals& bounds,
+                         const Ints& index, const pair& z)
+{
+  using namespace regiongrid;
+  layout L(index);
+  Int b=cell(z.gety(),bounds[Y0],bounds[INVH],L.B);
+  Int c=cell(z.getx(),bounds[X0],bounds[INVW],L.C);
+  Int k=b*L.C+c;
+
+  count=index[L.suffix()+k];
+
+  for(Int e=index[L.cells()+k]; e < index[L.cells()+k+1]; ++e)
+    if(addsegment(g,bounds,index,L,index[e],z,count)) return false;
+
+  for(Int e=index[L.wide()+b]; e < index[L.wide()+b+1]; ++e) {
+    Int s=index[e];
+    size_t h=L.hulls()+4*s;
+    if(cell(bounds[h],bounds[X0],bounds[INVW],L.C) <= c &&
+       c <= cell(bounds[h+1],bounds[X0],bounds[INVW],L.C) &&
+       addsegment(g,bounds,index,L,s,z,count)) return false;
+  }
+
+  for(Int e=index[L.events()+b]; e < index[L.events()+b+1]; ++e) {
+    if(index[L.eventdata()+2*e] <= c) break;
+    if(bounds[L.heights()+e] <= z.gety())
+      count += index[L.eventdata()+2*e+1];
+  }
+  return true;
+}
+
   
 // Concatenates two paths into a new one.
 path concat(const path& p1, const path& p2);
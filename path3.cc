@@ -6,6 +6,7 @@
  *****/
 
 #include <cfloat>
+#include <algorithm>
 
 #include "path3.h"
 #include "util.h"
@@ -272,6 +273,37 @@ static inline void derivative(triple& a, triple& b, triple& c,
   c=c0-z0;
 }
 
+// Store in t the times in (0,1) at which the x, y, and then the z coordinate
+// of the nonstraight segment i of g attain an extremum, returning their
+// number.
+template<class P>
+static inline int extrema(const P& g, Int i, double *t)
+{
+  triple a,b,c;
+  derivative(a,b,c,g.point(i),g.postcontrol(i),g.precontrol(i+1),
+             g.point(i+1));
+
+  int n=0;
+  quadraticroots x(a.getx(),b.getx(),c.getx());
+  if(x.distinct != quadraticroots::NONE && goodroot(x.t1))
+    t[n++]=x.t1;
+  if(x.distinct == quadraticroots::TWO && goodroot(x.t2))
+    t[n++]=x.t2;
+
+  quadraticroots y(a.gety(),b.gety(),c.gety());
+  if(y.distinct != quadraticroots::NONE && goodroot(y.t1))
+    t[n++]=y.t1;
+  if(y.distinct == quadraticroots::TWO && goodroot(y.t2))
+    t[n++]=y.t2;
+
+  quadraticroots z(a.getz(),b.getz(),c.getz());
+  if(z.distinct != quadraticroots::NONE && goodroot(z.t1))
+    t[n++]=z.t1;
+  if(z.distinct == quadraticroots::TWO && goodroot(z.t2))
+    t[n++]=z.t2;
+  return n;
+}
+
 bbox3 path3::bounds() const
 {
   if(!box.empty) return box;
@@ -289,29 +321,9 @@ bbox3 path3::bounds() const
     addpoint(box,i);
     if(straight(i)) continue;
     
-    triple a,b,c;
-    derivative(a,b,c,point(i),postcontrol(i),precontrol(i+1),point(i+1));
-    
-    // Check x coordinate
-    quadraticroots x(a.getx(),b.getx(),c.getx());
-    if(x.distinct != quadraticroots::NONE && goodroot(x.t1))
-      addpoint(box,i+x.t1);
-    if(x.distinct == quadraticroots::TWO && goodroot(x.t2))
-      addpoint(box,i+x.t2);
-    
-    // Check y coordinate
-    quadraticroots y(a.gety(),b.gety(),c.gety());
-    if(y.distinct != quadraticroots::NONE && goodroot(y.t1))
-      addpoint(box,i+y.t1);
-    if(y.distinct == quadraticroots::TWO && goodroot(y.t2))
-      addpoint(box,i+y.t2);
-    
-    // Check z coordinate
-    quadraticroots z(a.getz(),b.getz(),c.getz());
-    if(z.distinct != quadraticroots::NONE && goodroot(z.t1))
-      addpoint(box,i+z.t1);
-    if(z.distinct == quadraticroots::TWO && goodroot(z.t2))
-      addpoint(box,i+z.t2);
+    double t[6];
+    for(int k=0, m=extrema(*this,i,t); k < m; ++k)
+      addpoint(box,i+t[k]);
   }
   return box;
 }
@@ -419,26 +431,36 @@ double path3::cubiclength(Int i, double goal) const
 double path3::arclength() const
 {
   if (cached_length != -1) return cached_length;
+  if (empty()) return cached_length=0.0;
+  return arclength(length());
+}
 
-  double L=0.0;
-  for (Int i = 0; i < n-1; i++) {
-    L += cubiclength(i);
+double path3::arclength(Int i) const
+{
+  if (arclengths.empty()) {
+    Int len=length();
+    arclengths.resize(len+1);
+    double L=0.0;
+    arclengths[0]=L;
+    for (Int j = 0; j < len; j++)
+      arclengths[j+1]=L += cubiclength(j);
+    cached_length = L;
   }
-  if(cycles) L += cubiclength(n-1);
-  cached_length = L;
-  return cached_length;
+  return arclengths[i];
 }
 
+// Locate the segment containing the goal by bisecting the cumulative
+// arclengths, then solve for the time within that segment.
 double path3::arctime(double goal) const
 {
   if (cycles) {
-    if (goal == 0 || cached_length == 0) return 0;
+    if (goal == 0 || arclength() == 0) return 0;
     if (goal < 0)  {
       const path3 &rp = this->reverse();
       double result = -rp.arctime(-goal);
       return result;
     }
-    if (cached_length > 0 && goal >= cached_length) {
+    if (goal >= cached_length) {
       Int loops = (Int)(goal / cached_length);
       goal -= loops*cached_length;
       return loops*n+arctime(goal);
@@ -446,47 +468,184 @@ double path3::arctime(double goal) const
   } else {
     if (goal <= 0)
       return 0;
-    if (cached_length > 0 && goal >= cached_length)
+    if (goal >= arclength())
       return n-1;
   }
-    
-  double l,L=0;
-  for (Int i = 0; i < n-1; i++) {
-    l = cubiclength(i,goal);
-    if (l < 0)
-      return (-l+i);
-    else {
-      L += l;
-      goal -= l;
-      if (goal <= 0)
-        return i+1;
+
+  arclength(0);
+  Int i=std::lower_bound(arclengths.begin()+1,arclengths.end(),goal)-
+    arclengths.begin()-1;
+  double l=cubiclength(i,goal-arclengths[i]);
+  return l < 0 ? i-l : i+1;
+}
+
+// }}}
+
+// {{{ Path3 Intersection Calculations
+
+// A subpath3 used by intersections: either a range of the nodes of an
+// existing path3 or a single subdivided segment held by value, so that the
+// recursive subdivision allocates no new path3s. The member functions
+// reproduce the arithmetic of the path3 member functions of the same name.
+class path3view {
+  const solvedKnot3 *base; // Nodes of the original path3, or NULL.
+  Int N;                   // Number of nodes of the original path3.
+  bool basecycles;
+  Int offset;              // Index in the original path3 of node 0.
+  solvedKnot3 segment[2];  // Nodes of a subdivided segment.
+  Int n;
+  bool cycles;
+  bool trimmed;            // Whether the ends are clamped, as by subpath.
+
+  const solvedKnot3& node(Int i) const {
+    if(!base) return segment[i];
+    Int j=offset+i;
+    return base[basecycles ? imod(j,N) : j];
+  }
+
+  triple pre(Int i) const {
+    return trimmed && i == 0 ? node(i).point : node(i).pre;
+  }
+
+  triple post(Int i) const {
+    return trimmed && i == n-1 ? node(i).point : node(i).post;
+  }
+
+public:
+  path3view()
+    : base(NULL), N(0), basecycles(false), offset(0), n(0), cycles(false),
+      trimmed(false) {}
+
+  path3view(path3& p)
+    : base(p.Nodes().data()), N(p.size()), basecycles(p.cyclic()), offset(0),
+      n(p.size()), cycles(p.cyclic()), trimmed(false) {}
+
+  // A segment, clamped as by the path3 constructor.
+  path3view(const solvedKnot3& n1, const solvedKnot3& n2)
+    : base(NULL), N(0), basecycles(false), offset(0), n(2), cycles(false),
+      trimmed(true)
+  {
+    segment[0]=n1;
+    segment[1]=n2;
+    segment[0].pre=segment[0].point;
+    segment[1].post=segment[1].point;
+  }
+
+  friend bool operator== (const path3view& p, const path3view& q)
+  {
+    if(p.cycles != q.cycles || p.n != q.n) return false;
+    for(Int i=0; i < p.n; ++i)
+      if(p.pre(i) != q.pre(i) || p.node(i).point != q.node(i).point ||
+         p.post(i) != q.post(i)) return false;
+    return true;
+  }
+
+  Int length() const {
+    return cycles ? n : n-1;
+  }
+
+  bool cyclic() const {
+    return cycles;
+  }
+
+  bool straight(Int t) const {
+    if(cycles) return node(imod(t,n)).straight;
+    return (t >= 0 && t < n) ? node(t).straight : false;
+  }
+
+  triple point(Int t) const {
+    return node(adjustedIndex(t,n,cycles)).point;
+  }
+
+  triple precontrol(Int t) const {
+    return pre(adjustedIndex(t,n,cycles));
+  }
+
+  triple postcontrol(Int t) const {
+    return post(adjustedIndex(t,n,cycles));
+  }
+
+  triple point(double t) const
+  {
+    checkEmpty3(n);
+
+    Int i=Floor(t);
+    Int iplus;
+    t=fmod(t,1);
+    if(t < 0) t += 1;
+
+    if(cycles) {
+      i=imod(i,n);
+      iplus=imod(i+1,n);
     }
+    else if(i < 0)
+      return node(0).point;
+    else if(i >= n-1)
+      return node(n-1).point;
+    else
+      iplus=i+1;
+
+    double one_t=1.0-t;
+
+    triple a=node(i).point,
+      b=post(i),
+      c=pre(iplus),
+      d=node(iplus).point,
+      ab=one_t*a+t*b,
+      bc=one_t*b+t*c,
+      cd=one_t*c+t*d,
+      abc=one_t*ab+t*bc,
+      bcd=one_t*bc+t*cd,
+      abcd=one_t*abc+t*bcd;
+
+    return abcd;
   }
-  if (cycles) {
-    l = cubiclength(n-1,goal);
-    if (l < 0)
-      return -l+n-1;
-    if (cached_length > 0 && cached_length != L+l) {
-      reportError("arclength != length.\n"
-                  "path3::arclength(double) must have broken semantics.\n"
-                  "Please report this error.");
+
+  // The subpath from node a to node b, where 0 <= a < b <= length().
+  path3view subpath(Int a, Int b) const
+  {
+    path3view v(*this);
+    if(base) {
+      v.offset=offset+a;
+      v.n=b-a+1;
     }
-    cached_length = L += l;
-    goal -= l;
-    return arctime(goal)+n;
+    v.cycles=false;
+    v.trimmed=true;
+    return v;
   }
-  else {
-    cached_length = L;
-    return length();
+
+  void halve(path3view& first, path3view& second) const
+  {
+    solvedKnot3 sn[3];
+    splitCubic(sn,0.5,node(0),node(adjustedIndex(1,n,cycles)));
+    first=path3view(sn[0],sn[1]);
+    second=path3view(sn[1],sn[2]);
   }
-}
 
-// }}}
+  // Compute the bounding box as by path3::bounds.
+  void extent(triple& min, triple& max) const
+  {
+    checkEmpty3(n);
+    bbox3 box;
+    Int len=length();
+    box.add(point(len));
 
-// {{{ Path3 Intersection Calculations
+    for(Int i=0; i < len; i++) {
+      box.addnonempty(point(i));
+      if(straight(i)) continue;
+
+      double t[6];
+      for(int k=0, m=extrema(*this,i,t); k < m; ++k)
+        box.addnonempty(point(i+t[k]));
+    }
+    min=box.Min();
+    max=box.Max();
+  }
+};
 
 // Return all intersection times of path3 g with the triple v.
-void intersections(std::vector<double>& T, const path3& g, const triple& v,
+template<class P>
+void intersections(std::vector<double>& T, const P& g, const triple& v,
                    double fuzz)
 {
   double fuzz2=fuzz*fuzz;
@@ -519,8 +678,9 @@ void intersections(std::vector<double>& T, const path3& g, const triple& v,
 // An optimized implementation of intersections(g,p--q);
 // if there are an infinite number of intersection points, the returned list is
 // only guaranteed to include the endpoint times of the intersection.
+template<class P>
 void intersections(std::vector<double>& S, std::vector<double>& T,
-                   const path3& g, const triple& p, double fuzz)
+                   const P& g, const triple& p, double fuzz)
 {
   std::vector<double> S1;
   intersections(S1,g,p,fuzz);
@@ -532,7 +692,7 @@ void intersections(std::vector<double>& S, std::vector<double>& T,
 }
 
 void add(std::vector<double>& S, std::vector<double>& T, double s, double t,
-         const path3& p, const path3& q, double fuzz2)
+         const path3view& p, const path3view& q, double fuzz2)
 {
   triple P=p.point(s);
   for(size_t i=0; i < S.size(); ++i)
@@ -544,7 +704,7 @@ void add(std::vector<double>& S, std::vector<double>& T, double s, double t,
 void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
          std::vector<double>& S1, std::vector<double>& T1,
          double pscale, double qscale, double poffset, double qoffset,
-         const path3& p, const path3& q, double fuzz2, bool single)
+         const path3view& p, const path3view& q, double fuzz2, bool single)
 {
   if(single) {
     s=s*pscale+poffset;
@@ -558,7 +718,7 @@ void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
 
 void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
          std::vector<double>& S1, std::vector<double>& T1,
-         const path3& p, const path3& q, double fuzz2, bool single)
+         const path3view& p, const path3view& q, double fuzz2, bool single)
 {
   size_t n=S1.size();
   if(single) {
@@ -573,8 +733,9 @@ void add(double& s, double& t, std::vector<double>& S, std::vector<double>& T,
 }
 
 bool intersections(double &s, double &t, std::vector<double>& S,
-                   std::vector<double>& T, path3& p, path3& q,
-                   double fuzz, bool single, bool exact, unsigned depth)
+                   std::vector<double>& T, const path3view& p,
+                   const path3view& q, double fuzz, bool single, bool exact,
+                   unsigned depth)
 {
   if(errorstream::interrupt) throw interrupted();
   
@@ -597,10 +758,9 @@ bool intersections(double &s, double &t, std::vector<double>& S,
     return S1.size() > 0;
   }
   
-  triple maxp=p.max();
-  triple minp=p.min();
-  triple maxq=q.max();
-  triple minq=q.min();
+  triple minp,maxp,minq,maxq;
+  p.extent(minp,maxp);
+  q.extent(minq,maxq);
   
   if(maxp.getx()+fuzz >= minq.getx() &&
      maxp.gety()+fuzz >= minq.gety() && 
@@ -622,7 +782,7 @@ bool intersections(double &s, double &t, std::vector<double>& S,
       return true;
     }
     
-    path3 p1,p2;
+    path3view p1,p2;
     double pscale,poffset;
     
     std::vector<double> S1,T1;
@@ -643,7 +803,7 @@ bool intersections(double &s, double &t, std::vector<double>& S,
       pscale=1.0;
     }
       
-    path3 q1,q2;
+    path3view q1,q2;
     double qscale,qoffset;
     
     if(lq <= 1) {
@@ -710,6 +870,14 @@ bool intersections(double &s, double &t, std::vector<double>& S,
   return false;
 }
 
+bool intersections(double &s, double &t, std::vector<double>& S,
+                   std::vector<double>& T, path3& p, path3& q,
+                   double fuzz, bool single, bool exact, unsigned depth)
+{
+  return intersections(s,t,S,T,path3view(p),path3view(q),fuzz,single,exact,
+                       depth);
+}
+
 // }}}
 
 path3 concat(const path3& p1, const path3& p2)
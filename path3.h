@@ -47,6 +47,7 @@ class path3 : public gc {
 
   mem::vector<solvedKnot3> nodes;
   mutable double cached_length; // Cache length since path3 is immutable.
+  mutable mem::vector<double> arclengths; // Arclength to each node.
   
   mutable bbox3 box;
   mutable bbox3 times; // Times where minimum and maximum extents are attained.
@@ -89,7 +90,7 @@ public:
   // Copy constructor
   path3(const path3& p)
     : cycles(p.cycles), n(p.n), nodes(p.nodes), cached_length(p.cached_length),
-      box(p.box)
+      arclengths(p.arclengths), box(p.box)
   {}
 
   path3 unstraighten() const
@@ -304,6 +305,8 @@ public:
 
   double cubiclength(Int i, double goal=-1) const;
   double arclength () const;
+  // Return the arclength from node 0 to node i, where 0 <= i <= length().
+  double arclength(Int i) const;
   double arctime (double l) const;
  
   triple max() const {
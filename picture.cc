@@ -6,6 +6,8 @@
  * PostScript. 
  *****/
 
+#include <algorithm>
+
 #include "errormsg.h"
 #include "picture.h"
 #include "util.h"
@@ -13,6 +15,7 @@
 #include "interact.h"
 #include "drawverbatim.h"
 #include "drawlabel.h"
+#include "labelcache.h"
 #include "drawlayer.h"
 #include "drawsurface.h"
 
@@ -29,7 +32,7 @@ texstream::~texstream() {
   string name;
   if(!context) 
     name=stripFile(outname());
-  name += "texput.";
+  name += (jobname.empty() ? "texput" : jobname)+".";
   unlink((name+"aux").c_str());
   unlink((name+"log").c_str());
   unlink((name+"out").c_str());
@@ -258,6 +261,36 @@ bool picture::havenewpage()
   return false;
 }
 
+void picture::measurelabels(nodelist::iterator p)
+{
+  mem::vector<drawLabel *> labels;
+  for(; p != nodes.end(); ++p) {
+    assert(*p);
+    if((*p)->islabel()) {
+      if(dynamic_cast<drawVerbatim *>(*p)) break;
+      drawLabel *L=dynamic_cast<drawLabel *>(*p);
+      if(L) labels.push_back(L);
+    }
+  }
+  drawLabel::lookup(labels);
+  if(labels.empty()) return;
+  
+  // Only start auxiliary TeX processes for pictures with many labels.
+  static const size_t minlabels=256;
+  
+  processDataStruct &pd=processData();
+  texpipes pipes;
+  pipes.push_back(texpipe(&pd.tex,&drawElement::lastpen));
+  size_t n=min((size_t) max(getSetting<Int>("texprocesses"),(Int) 1),
+               labels.size()/minlabels+1);
+  if(n > 1) {
+    mem::vector<texworker *>& w=texworkers(n-1);
+    for(size_t i=0; i < n-1; ++i)
+      pipes.push_back(texpipe(&w[i]->tex,&w[i]->lastpen));
+  }
+  drawLabel::getbounds(labels,pipes,getSetting<string>("tex"));
+}
+
 bbox picture::bounds()
 {
   size_t n=nodes.size();
@@ -269,14 +302,22 @@ bbox picture::bounds()
     bboxstack.clear();
   }
   
-  if(havelabels()) texinit();
+  bool batch=havelabels();
+  if(batch) texinit();
   
   nodelist::iterator p=nodes.begin();
   for(size_t i=0; i < lastnumber; ++i) ++p;
+  if(batch) measurelabels(p);
   for(; p != nodes.end(); ++p) {
     assert(*p);
     (*p)->bounds(b_cached,processData().tex,labelbounds,bboxstack);
     
+    // Verbatim TeX may affect the metrics of subsequent labels.
+    if(batch && (*p)->islabel() && dynamic_cast<drawVerbatim *>(*p)) {
+      nodelist::iterator q=p;
+      measurelabels(++q);
+    }
+    
     // Optimization for interpreters with fixed stack limits.
     if((*p)->endclip()) {
       nodelist::iterator q=p;
@@ -337,6 +378,70 @@ pair picture::ratio(double (*m)(double, double))
   return b;
 }
   
+// Start a TeX pipe, initialized with the given preamble. Auxiliary pipes,
+// numbered from 1 by worker, are given job names of their own, so that
+// their log and aux files are not shared with the main pipe.
+void opentexpipe(texstream& tex, mem::list<string>& preamble, size_t worker)
+{
+  bool context=settings::context(getSetting<string>("tex"));
+  string dir=stripFile(outname());
+  
+  mem::vector<string> cmd;
+  cmd.push_back(texprogram());
+  if(context) {
+    cmd.push_back("--pipe");
+  } else {
+    if(!dir.empty()) 
+      cmd.push_back("-output-directory="+dir.substr(0,dir.length()-1));
+    string jobname;
+    if(getSetting<bool>("inlineimage") || getSetting<bool>("inlinetex")) {
+      string name=stripDir(stripExt((outname())));
+      size_t pos=name.rfind("-");
+      if(pos < string::npos) {
+        name=stripExt(name).substr(0,pos);
+        if(worker == 0) unlink((name+".aux").c_str());
+        jobname=name.substr(0,pos);
+      }
+    }
+    if(worker > 0) {
+      ostringstream buf;
+      buf << (jobname.empty() ? "texput" : jobname) << "_" << worker;
+      jobname=tex.jobname=buf.str();
+    }
+    if(!jobname.empty()) {
+      cmd.push_back("-jobname="+jobname);
+#ifdef __MSDOS__
+      cmd.push_back("NUL"); // For MikTeX
+#endif
+    }
+    cmd.push_back("\\scrollmode");
+  }
+  
+  tex.open(cmd,"texpath",texpathmessage());
+  tex.wait("\n*");
+  tex << "\n";
+  texdocumentclass(tex,true);
+  
+  texdefines(tex,preamble,true);
+}
+
+// Return n auxiliary TeX pipes brought up to date with the main TeX pipe.
+mem::vector<texworker *>& texworkers(size_t n)
+{
+  processDataStruct &pd=processData();
+  while(pd.texworkers.size() < n) {
+    texworker *w=new texworker;
+    opentexpipe(w->tex,pd.TeXpipeinitial,pd.texworkers.size()+1);
+    pd.texworkers.push_back(w);
+  }
+  for(size_t i=0; i < n; ++i) {
+    texworker *w=pd.texworkers[i];
+    for(; w->synced < pd.TeXpipelog.size(); ++w->synced)
+      w->tex << pd.TeXpipelog[w->synced];
+  }
+  return pd.texworkers;
+}
+
 void texinit()
 {
   drawElement::lastpen=pen(initialpen);
@@ -345,6 +450,12 @@ void texinit()
   if(pd.tex.isopen()) {
     if(pd.TeXpipepreamble.empty()) return;
     texpreamble(pd.tex,pd.TeXpipepreamble,false);
+    ostringstream buf;
+    texpreamble(buf,pd.TeXpipepreamble,false);
+    pd.TeXpipelog.push_back(buf.str());
+    for(mem::list<string>::iterator p=pd.TeXpipepreamble.begin();
+        p != pd.TeXpipepreamble.end(); ++p)
+      labelcache::append(*p);
     pd.TeXpipepreamble.clear();
     return;
   }
@@ -362,34 +473,11 @@ void texinit()
     writeable.close();
   unlink(cname);
   
-  mem::vector<string> cmd;
-  cmd.push_back(texprogram());
-  if(context) {
-    cmd.push_back("--pipe");
-  } else {
-    if(!dir.empty()) 
-      cmd.push_back("-output-directory="+dir.substr(0,dir.length()-1));
-    if(getSetting<bool>("inlineimage") || getSetting<bool>("inlinetex")) {
-      string name=stripDir(stripExt((outname())));
-      size_t pos=name.rfind("-");
-      if(pos < string::npos) {
-        name=stripExt(name).substr(0,pos);
-        unlink((name+".aux").c_str());
-        cmd.push_back("-jobname="+name.substr(0,pos));
-#ifdef __MSDOS__
-        cmd.push_back("NUL"); // For MikTeX
-#endif
-      }
-    }
-    cmd.push_back("\\scrollmode");
-  }
-  
-  pd.tex.open(cmd,"texpath",texpathmessage());
-  pd.tex.wait("\n*");
-  pd.tex << "\n";
-  texdocumentclass(pd.tex,true);
-  
-  texdefines(pd.tex,pd.TeXpreamble,true);
+  pd.closetexworkers();
+  opentexpipe(pd.tex,pd.TeXpreamble);
+  labelcache::reset(getSetting<string>("tex"),pd.TeXpreamble);
+  pd.TeXpipeinitial=pd.TeXpreamble;
+  pd.TeXpipelog.clear();
   pd.TeXpipepreamble.clear();
 }
   
@@ -1173,16 +1261,112 @@ bool picture::shipout(picture *preamble, const string& Prefix,
   return true;
 }
 
+#ifdef HAVE_RENDER
+// Tessellate every count-th node, starting from the node start.
+struct tessellatetask {
+  const std::vector<drawElement *> *nodes;
+  size_t start,count;
+  const double *T;
+  double size2;
+  triple Min,Max;
+  double perspective;
+
+  void run() {
+    for(size_t i=start; i < nodes->size(); i += count)
+      (*nodes)[i]->tessellate(T,size2,Min,Max,perspective);
+  }
+};
+
+#ifdef HAVE_PTHREAD
+void *runtessellatetask(void *task)
+{
+  ((tessellatetask *) task)->run();
+  return NULL;
+}
+#endif
+
+// Minimum number of nodes for each additional thread.
+const size_t nodesPerThread=256;
+
+// Tessellate the surfaces of the picture concurrently into the meshes that
+// they cache, so that rendering them only needs to draw. Each surface has
+// its own mesh and the meshes are drawn in the order of the nodes, so the
+// output does not depend on the number of threads. A node that appears more
+// than once in the picture is tessellated only once, so that no two threads
+// write to the same mesh.
+void tessellate(const std::vector<drawElement *>& nodes, double size2,
+                const triple& Min, const triple& Max, double perspective)
+{
+  size_t threads=max(threadCount(),1U);
+  if(threads <= 1 || nodes.size() < 2*nodesPerThread) return;
+  
+  std::vector<drawElement *> v(nodes);
+  std::sort(v.begin(),v.end());
+  v.erase(std::unique(v.begin(),v.end()),v.end());
+  
+  size_t n=v.size();
+  size_t count=min(threads,max(n/nodesPerThread,(size_t) 1));
+  if(count <= 1) return;
+  
+  double t[16];
+  getModelview(t);
+  run::transpose(t,4);
+  run::inverse(t,4);
+  
+  std::vector<tessellatetask> tasks(count);
+  for(size_t k=0; k < count; ++k) {
+    tessellatetask& task=tasks[k];
+    task.nodes=&v;
+    task.start=k;
+    task.count=count;
+    task.T=t;
+    task.size2=size2;
+    task.Min=Min;
+    task.Max=Max;
+    task.perspective=perspective;
+  }
+  
+#ifdef HAVE_PTHREAD
+  std::vector<pthread_t> thread(count);
+  std::vector<bool> started(count,false);
+  for(size_t k=1; k < count; ++k)
+    started[k]=pthread_create(&thread[k],NULL,runtessellatetask,
+                              &tasks[k]) == 0;
+  runtessellatetask(&tasks[0]);
+  for(size_t k=1; k < count; ++k) {
+    if(started[k]) pthread_join(thread[k],NULL);
+    else runtessellatetask(&tasks[k]);
+  }
+#else
+  for(size_t k=0; k < count; ++k)
+    tasks[k].run();
+#endif
+}
+#endif  
+
 // render viewport with width x height pixels.
 void picture::render(GLUnurbs *nurb, double size2,
                      const triple& Min, const triple& Max,
                      double perspective, bool lighton, bool transparent) const
 {
-  for(nodelist::const_iterator p=nodes.begin(); p != nodes.end(); ++p) {
-    assert(*p);
-    (*p)->render(nurb,size2,Min,Max,perspective,lighton,transparent);
+  std::vector<drawElement *> v(nodes.begin(),nodes.end());
+  render(v,nurb,size2,Min,Max,perspective,lighton,transparent);
+}
+
+void picture::render(const std::vector<drawElement *>& v, GLUnurbs *nurb,
+                     double size2, const triple& Min, const triple& Max,
+                     double perspective, bool lighton, bool transparent)
+{
+#ifdef HAVE_RENDER
+  // The opaque pass comes first and tessellates the transparent surfaces too.
+  if(!transparent)
+    tessellate(v,size2,Min,Max,perspective);
+#endif  
+  for(size_t i=0; i < v.size(); ++i) {
+    assert(v[i]);
+    v[i]->render(nurb,size2,Min,Max,perspective,lighton,transparent);
   }
-#ifdef HAVE_GL
+#ifdef HAVE_RENDER
   drawBezierPatch::S.draw();
 #endif  
 }
@@ -1236,12 +1420,12 @@ bool picture::shipout3(const string& prefix, const string& format,
     return true;
   
 #ifndef HAVE_LIBGLUT
-  if(!getSetting<bool>("offscreen"))
+  if(!getSetting<bool>("offscreen") && !getSetting<bool>("software"))
     camp::reportError("to support onscreen rendering, please install glut library, run ./configure, and recompile");
 #endif
   
 #ifndef HAVE_LIBOSMESA
-  if(getSetting<bool>("offscreen"))
+  if(getSetting<bool>("offscreen") && !getSetting<bool>("software"))
     camp::reportError("to support offscreen rendering; please install OSMesa library, run ./configure --enable-offscreen, and recompile");
 #endif
   
@@ -1273,9 +1457,21 @@ bool picture::shipout3(const string& prefix, const string& format,
   const string outputformat=format.empty() ? 
     getSetting<string>("outformat") : format;
   
+#ifdef HAVE_RENDER
+  static int oldpid=0;
+  
+  // The software rasterizer needs neither OpenGL, a window, nor a separate
+  // process.
+  if(getSetting<bool>("software")) {
+    glrender(prefix,pic,outputformat,width,height,angle,zoom,m,M,shift,t,
+             background,nlights,lights,diffuse,ambient,specular,
+             viewportlighting,false,oldpid);
+    return true;
+  }
+#endif
+
 #ifdef HAVE_GL  
   bool View=settings::view() && view;
-  static int oldpid=0;
   bool offscreen=getSetting<bool>("offscreen");
 #ifdef HAVE_PTHREAD
   bool animating=getSetting<bool>("animating");
@@ -55,6 +55,10 @@ public:
   void prepend(picture &pic);
   
   bool havelabels();
+  
+  // Measure the labels from p up to the next verbatim TeX command.
+  void measurelabels(nodelist::iterator p);
+  
   bool have3D();
   bool havepng();
   bool havenewpage();
@@ -89,6 +93,11 @@ public:
   void render(GLUnurbs *nurb, double size2,
               const triple &Min, const triple& Max, double perspective,
               bool lighton, bool transparent) const;
+  
+  // Render only the nodes v, in order.
+  static void render(const std::vector<drawElement *>& v, GLUnurbs *nurb,
+                     double size2, const triple &Min, const triple& Max,
+                     double perspective, bool lighton, bool transparent);
   bool shipout3(const string& prefix, const string& format,
                 double width, double height, double angle, double zoom,
                 const triple& m, const triple& M, const pair& shift, double *t,
@@ -121,6 +130,9 @@ inline picture *transformed(const vm::array& t, picture *p)
 }
 
 void texinit();
+void opentexpipe(texstream& tex, mem::list<string>& preamble,
+                 size_t worker=0);
+mem::vector<texworker *>& texworkers(size_t n);
 int opentex(const string& texname, const string& prefix, bool dvi=false);
 
 const char *texpathmessage();
@@ -2782,3 +2782,422 @@ REAL insphere(const REAL *pa, const REAL *pb, const REAL *pc, const REAL *pd, co
   FPU_RESTORE;
   return ins;
 }
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Batched predicates.                                                      */
+/*                                                                           */
+/*  The floating-point filters of orient2d(), orient3d(), incircle(), and    */
+/*  insphere() are evaluated for a block of queries at once, four lanes to a */
+/*  vector on processors supporting AVX2. Only the queries the filter cannot */
+/*  decide are passed to the single-query routines, so the results are       */
+/*  identical to theirs. Fused multiply-adds are avoided so that the filter  */
+/*  rounds exactly as the scalar code does.                                  */
+/*                                                                           */
+/*****************************************************************************/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_DISPATCH
+#endif
+
+namespace {
+
+const size_t lanes=4;
+
+/* Coordinates x[point][coordinate][lane] of a block of queries, with the   */
+/* determinant computed by the filter and its error bound.                   */
+struct block {
+  double x[5][3][lanes];
+  double det[lanes];
+  double errbound[lanes];
+};
+
+/* Gather the coordinates of queries start,...,start+m-1, padding unused     */
+/* lanes with zeros.                                                         */
+void gather(block& B, const double * const *P, size_t points, size_t dim,
+            size_t start, size_t m)
+{
+  for(size_t i=0; i < points; ++i)
+    for(size_t j=0; j < dim; ++j) {
+      for(size_t k=0; k < m; ++k)
+        B.x[i][j][k]=P[i][dim*(start+k)+j];
+      for(size_t k=m; k < lanes; ++k)
+        B.x[i][j][k]=0.0;
+    }
+}
+
+void orient2dfilter(block& B)
+{
+  for(size_t k=0; k < lanes; ++k) {
+    REAL detleft=(B.x[0][0][k]-B.x[2][0][k])*(B.x[1][1][k]-B.x[2][1][k]);
+    REAL detright=(B.x[0][1][k]-B.x[2][1][k])*(B.x[1][0][k]-B.x[2][0][k]);
+    B.det[k]=detleft-detright;
+    B.errbound[k]=ccwerrboundA*(Absolute(detleft)+Absolute(detright));
+  }
+}
+
+void orient3dfilter(block& B)
+{
+  for(size_t k=0; k < lanes; ++k) {
+    REAL adx=B.x[0][0][k]-B.x[3][0][k];
+    REAL bdx=B.x[1][0][k]-B.x[3][0][k];
+    REAL cdx=B.x[2][0][k]-B.x[3][0][k];
+    REAL ady=B.x[0][1][k]-B.x[3][1][k];
+    REAL bdy=B.x[1][1][k]-B.x[3][1][k];
+    REAL cdy=B.x[2][1][k]-B.x[3][1][k];
+    REAL adz=B.x[0][2][k]-B.x[3][2][k];
+    REAL bdz=B.x[1][2][k]-B.x[3][2][k];
+    REAL cdz=B.x[2][2][k]-B.x[3][2][k];
+    REAL bdxcdy=bdx*cdy, cdxbdy=cdx*bdy;
+    REAL cdxady=cdx*ady, adxcdy=adx*cdy;
+    REAL adxbdy=adx*bdy, bdxady=bdx*ady;
+    B.det[k]=adz*(bdxcdy-cdxbdy)+bdz*(cdxady-adxcdy)+cdz*(adxbdy-bdxady);
+    REAL permanent=(Absolute(bdxcdy)+Absolute(cdxbdy))*Absolute(adz)
+      +(Absolute(cdxady)+Absolute(adxcdy))*Absolute(bdz)
+      +(Absolute(adxbdy)+Absolute(bdxady))*Absolute(cdz);
+    B.errbound[k]=o3derrboundA*permanent;
+  }
+}
+
+void incirclefilter(block& B)
+{
+  for(size_t k=0; k < lanes; ++k) {
+    REAL adx=B.x[0][0][k]-B.x[3][0][k];
+    REAL bdx=B.x[1][0][k]-B.x[3][0][k];
+    REAL cdx=B.x[2][0][k]-B.x[3][0][k];
+    REAL ady=B.x[0][1][k]-B.x[3][1][k];
+    REAL bdy=B.x[1][1][k]-B.x[3][1][k];
+    REAL cdy=B.x[2][1][k]-B.x[3][1][k];
+    REAL bdxcdy=bdx*cdy, cdxbdy=cdx*bdy;
+    REAL alift=adx*adx+ady*ady;
+    REAL cdxady=cdx*ady, adxcdy=adx*cdy;
+    REAL blift=bdx*bdx+bdy*bdy;
+    REAL adxbdy=adx*bdy, bdxady=bdx*ady;
+    REAL clift=cdx*cdx+cdy*cdy;
+    B.det[k]=alift*(bdxcdy-cdxbdy)+blift*(cdxady-adxcdy)
+      +clift*(adxbdy-bdxady);
+    REAL permanent=(Absolute(bdxcdy)+Absolute(cdxbdy))*alift
+      +(Absolute(cdxady)+Absolute(adxcdy))*blift
+      +(Absolute(adxbdy)+Absolute(bdxady))*clift;
+    B.errbound[k]=iccerrboundA*permanent;
+  }
+}
+
+void inspherefilter(block& B)
+{
+  for(size_t k=0; k < lanes; ++k) {
+    REAL aex=B.x[0][0][k]-B.x[4][0][k];
+    REAL bex=B.x[1][0][k]-B.x[4][0][k];
+    REAL cex=B.x[2][0][k]-B.x[4][0][k];
+    REAL dex=B.x[3][0][k]-B.x[4][0][k];
+    REAL aey=B.x[0][1][k]-B.x[4][1][k];
+    REAL bey=B.x[1][1][k]-B.x[4][1][k];
+    REAL cey=B.x[2][1][k]-B.x[4][1][k];
+    REAL dey=B.x[3][1][k]-B.x[4][1][k];
+    REAL aez=B.x[0][2][k]-B.x[4][2][k];
+    REAL bez=B.x[1][2][k]-B.x[4][2][k];
+    REAL cez=B.x[2][2][k]-B.x[4][2][k];
+    REAL dez=B.x[3][2][k]-B.x[4][2][k];
+
+    REAL aexbey=aex*bey, bexaey=bex*aey, ab=aexbey-bexaey;
+    REAL bexcey=bex*cey, cexbey=cex*bey, bc=bexcey-cexbey;
+    REAL cexdey=cex*dey, dexcey=dex*cey, cd=cexdey-dexcey;
+    REAL dexaey=dex*aey, aexdey=aex*dey, da=dexaey-aexdey;
+    REAL aexcey=aex*cey, cexaey=cex*aey, ac=aexcey-cexaey;
+    REAL bexdey=bex*dey, dexbey=dex*bey, bd=bexdey-dexbey;
+
+    REAL abc=aez*bc-bez*ac+cez*ab;
+    REAL bcd=bez*cd-cez*bd+dez*bc;
+    REAL cda=cez*da+dez*ac+aez*cd;
+    REAL dab=dez*ab+aez*bd+bez*da;
+
+    REAL alift=aex*aex+aey*aey+aez*aez;
+    REAL blift=bex*bex+bey*bey+bez*bez;
+    REAL clift=cex*cex+cey*cey+cez*cez;
+    REAL dlift=dex*dex+dey*dey+dez*dez;
+
+    B.det[k]=(dlift*abc-clift*dab)+(blift*cda-alift*bcd);
+
+    REAL aezplus=Absolute(aez), bezplus=Absolute(bez);
+    REAL cezplus=Absolute(cez), dezplus=Absolute(dez);
+    REAL aexbeyplus=Absolute(aexbey), bexaeyplus=Absolute(bexaey);
+    REAL bexceyplus=Absolute(bexcey), cexbeyplus=Absolute(cexbey);
+    REAL cexdeyplus=Absolute(cexdey), dexceyplus=Absolute(dexcey);
+    REAL dexaeyplus=Absolute(dexaey), aexdeyplus=Absolute(aexdey);
+    REAL aexceyplus=Absolute(aexcey), cexaeyplus=Absolute(cexaey);
+    REAL bexdeyplus=Absolute(bexdey), dexbeyplus=Absolute(dexbey);
+    REAL permanent=((cexdeyplus+dexceyplus)*bezplus
+                    +(dexbeyplus+bexdeyplus)*cezplus
+                    +(bexceyplus+cexbeyplus)*dezplus)*alift
+      +((dexaeyplus+aexdeyplus)*cezplus
+        +(aexceyplus+cexaeyplus)*dezplus
+        +(cexdeyplus+dexceyplus)*aezplus)*blift
+      +((aexbeyplus+bexaeyplus)*dezplus
+        +(bexdeyplus+dexbeyplus)*aezplus
+        +(dexaeyplus+aexdeyplus)*bezplus)*clift
+      +((bexceyplus+cexbeyplus)*aezplus
+        +(cexaeyplus+aexceyplus)*bezplus
+        +(aexbeyplus+bexaeyplus)*cezplus)*dlift;
+    B.errbound[k]=isperrboundA*permanent;
+  }
+}
+
+#ifdef HAVE_AVX2_DISPATCH
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 inline __m256d load(const double *x)
+{
+  return _mm256_loadu_pd(x);
+}
+
+AVX2 inline __m256d add(__m256d a, __m256d b)
+{
+  return _mm256_add_pd(a,b);
+}
+
+AVX2 inline __m256d sub(__m256d a, __m256d b)
+{
+  return _mm256_sub_pd(a,b);
+}
+
+AVX2 inline __m256d mul(__m256d a, __m256d b)
+{
+  return _mm256_mul_pd(a,b);
+}
+
+AVX2 inline __m256d abs(__m256d a)
+{
+  return _mm256_andnot_pd(_mm256_set1_pd(-0.0),a);
+}
+
+AVX2 void orient2dfilterAVX2(block& B)
+{
+  __m256d ax=load(B.x[0][0]), ay=load(B.x[0][1]);
+  __m256d bx=load(B.x[1][0]), by=load(B.x[1][1]);
+  __m256d cx=load(B.x[2][0]), cy=load(B.x[2][1]);
+  __m256d detleft=mul(sub(ax,cx),sub(by,cy));
+  __m256d detright=mul(sub(ay,cy),sub(bx,cx));
+  _mm256_storeu_pd(B.det,sub(detleft,detright));
+  _mm256_storeu_pd(B.errbound,mul(_mm256_set1_pd(ccwerrboundA),
+                                  add(abs(detleft),abs(detright))));
+}
+
+AVX2 void orient3dfilterAVX2(block& B)
+{
+  __m256d dx=load(B.x[3][0]), dy=load(B.x[3][1]), dz=load(B.x[3][2]);
+  __m256d adx=sub(load(B.x[0][0]),dx);
+  __m256d bdx=sub(load(B.x[1][0]),dx);
+  __m256d cdx=sub(load(B.x[2][0]),dx);
+  __m256d ady=sub(load(B.x[0][1]),dy);
+  __m256d bdy=sub(load(B.x[1][1]),dy);
+  __m256d cdy=sub(load(B.x[2][1]),dy);
+  __m256d adz=sub(load(B.x[0][2]),dz);
+  __m256d bdz=sub(load(B.x[1][2]),dz);
+  __m256d cdz=sub(load(B.x[2][2]),dz);
+  __m256d bdxcdy=mul(bdx,cdy), cdxbdy=mul(cdx,bdy);
+  __m256d cdxady=mul(cdx,ady), adxcdy=mul(adx,cdy);
+  __m256d adxbdy=mul(adx,bdy), bdxady=mul(bdx,ady);
+  __m256d det=add(add(mul(adz,sub(bdxcdy,cdxbdy)),
+                      mul(bdz,sub(cdxady,adxcdy))),
+                  mul(cdz,sub(adxbdy,bdxady)));
+  __m256d permanent=add(add(mul(add(abs(bdxcdy),abs(cdxbdy)),abs(adz)),
+                            mul(add(abs(cdxady),abs(adxcdy)),abs(bdz))),
+                        mul(add(abs(adxbdy),abs(bdxady)),abs(cdz)));
+  _mm256_storeu_pd(B.det,det);
+  _mm256_storeu_pd(B.errbound,mul(_mm256_set1_pd(o3derrboundA),permanent));
+}
+
+AVX2 void incirclefilterAVX2(block& B)
+{
+  __m256d dx=load(B.x[3][0]), dy=load(B.x[3][1]);
+  __m256d adx=sub(load(B.x[0][0]),dx);
+  __m256d bdx=sub(load(B.x[1][0]),dx);
+  __m256d cdx=sub(load(B.x[2][0]),dx);
+  __m256d ady=sub(load(B.x[0][1]),dy);
+  __m256d bdy=sub(load(B.x[1][1]),dy);
+  __m256d cdy=sub(load(B.x[2][1]),dy);
+  __m256d bdxcdy=mul(bdx,cdy), cdxbdy=mul(cdx,bdy);
+  __m256d alift=add(mul(adx,adx),mul(ady,ady));
+  __m256d cdxady=mul(cdx,ady), adxcdy=mul(adx,cdy);
+  __m256d blift=add(mul(bdx,bdx),mul(bdy,bdy));
+  __m256d adxbdy=mul(adx,bdy), bdxady=mul(bdx,ady);
+  __m256d clift=add(mul(cdx,cdx),mul(cdy,cdy));
+  __m256d det=add(add(mul(alift,sub(bdxcdy,cdxbdy)),
+                      mul(blift,sub(cdxady,adxcdy))),
+                  mul(clift,sub(adxbdy,bdxady)));
+  __m256d permanent=add(add(mul(add(abs(bdxcdy),abs(cdxbdy)),alift),
+                            mul(add(abs(cdxady),abs(adxcdy)),blift)),
+                        mul(add(abs(adxbdy),abs(bdxady)),clift));
+  _mm256_storeu_pd(B.det,det);
+  _mm256_storeu_pd(B.errbound,mul(_mm256_set1_pd(iccerrboundA),permanent));
+}
+
+AVX2 void inspherefilterAVX2(block& B)
+{
+  __m256d ex=load(B.x[4][0]), ey=load(B.x[4][1]), ez=load(B.x[4][2]);
+  __m256d aex=sub(load(B.x[0][0]),ex);
+  __m256d bex=sub(load(B.x[1][0]),ex);
+  __m256d cex=sub(load(B.x[2][0]),ex);
+  __m256d dex=sub(load(B.x[3][0]),ex);
+  __m256d aey=sub(load(B.x[0][1]),ey);
+  __m256d bey=sub(load(B.x[1][1]),ey);
+  __m256d cey=sub(load(B.x[2][1]),ey);
+  __m256d dey=sub(load(B.x[3][1]),ey);
+  __m256d aez=sub(load(B.x[0][2]),ez);
+  __m256d bez=sub(load(B.x[1][2]),ez);
+  __m256d cez=sub(load(B.x[2][2]),ez);
+  __m256d dez=sub(load(B.x[3][2]),ez);
+
+  __m256d aexbey=mul(aex,bey), bexaey=mul(bex,aey), ab=sub(aexbey,bexaey);
+  __m256d bexcey=mul(bex,cey), cexbey=mul(cex,bey), bc=sub(bexcey,cexbey);
+  __m256d cexdey=mul(cex,dey), dexcey=mul(dex,cey), cd=sub(cexdey,dexcey);
+  __m256d dexaey=mul(dex,aey), aexdey=mul(aex,dey), da=sub(dexaey,aexdey);
+  __m256d aexcey=mul(aex,cey), cexaey=mul(cex,aey), ac=sub(aexcey,cexaey);
+  __m256d bexdey=mul(bex,dey), dexbey=mul(dex,bey), bd=sub(bexdey,dexbey);
+
+  __m256d abc=add(sub(mul(aez,bc),mul(bez,ac)),mul(cez,ab));
+  __m256d bcd=add(sub(mul(bez,cd),mul(cez,bd)),mul(dez,bc));
+  __m256d cda=add(add(mul(cez,da),mul(dez,ac)),mul(aez,cd));
+  __m256d dab=add(add(mul(dez,ab),mul(aez,bd)),mul(bez,da));
+
+  __m256d alift=add(add(mul(aex,aex),mul(aey,aey)),mul(aez,aez));
+  __m256d blift=add(add(mul(bex,bex),mul(bey,bey)),mul(bez,bez));
+  __m256d clift=add(add(mul(cex,cex),mul(cey,cey)),mul(cez,cez));
+  __m256d dlift=add(add(mul(dex,dex),mul(dey,dey)),mul(dez,dez));
+
+  __m256d det=add(sub(mul(dlift,abc),mul(clift,dab)),
+                  sub(mul(blift,cda),mul(alift,bcd)));
+
+  __m256d aezplus=abs(aez), bezplus=abs(bez);
+  __m256d cezplus=abs(cez), dezplus=abs(dez);
+  __m256d aexbeyplus=abs(aexbey), bexaeyplus=abs(bexaey);
+  __m256d bexceyplus=abs(bexcey), cexbeyplus=abs(cexbey);
+  __m256d cexdeyplus=abs(cexdey), dexceyplus=abs(dexcey);
+  __m256d dexaeyplus=abs(dexaey), aexdeyplus=abs(aexdey);
+  __m256d aexceyplus=abs(aexcey), cexaeyplus=abs(cexaey);
+  __m256d bexdeyplus=abs(bexdey), dexbeyplus=abs(dexbey);
+  __m256d A=mul(add(add(mul(add(cexdeyplus,dexceyplus),bezplus),
+                        mul(add(dexbeyplus,bexdeyplus),cezplus)),
+                    mul(add(bexceyplus,cexbeyplus),dezplus)),alift);
+  __m256d Bl=mul(add(add(mul(add(dexaeyplus,aexdeyplus),cezplus),
+                         mul(add(aexceyplus,cexaeyplus),dezplus)),
+                     mul(add(cexdeyplus,dexceyplus),aezplus)),blift);
+  __m256d C=mul(add(add(mul(add(aexbeyplus,bexaeyplus),dezplus),
+                        mul(add(bexdeyplus,dexbeyplus),aezplus)),
+                    mul(add(dexaeyplus,aexdeyplus),bezplus)),clift);
+  __m256d D=mul(add(add(mul(add(bexceyplus,cexbeyplus),aezplus),
+                        mul(add(cexaeyplus,aexceyplus),bezplus)),
+                    mul(add(aexbeyplus,bexaeyplus),cezplus)),dlift);
+  __m256d permanent=add(add(add(A,Bl),C),D);
+  _mm256_storeu_pd(B.det,det);
+  _mm256_storeu_pd(B.errbound,mul(_mm256_set1_pd(isperrboundA),permanent));
+}
+
+#undef AVX2
+
+#endif
+
+typedef void (*filter)(block& B);
+
+/* Return whether the filter has decided lane k; orient2d() accepts a       */
+/* determinant equal to its error bound.                                     */
+inline bool decided(const block& B, size_t k, bool inclusive)
+{
+  REAL det=Absolute(B.det[k]);
+  return inclusive ? det >= B.errbound[k] : det > B.errbound[k];
+}
+
+/* Evaluate a predicate of the given number of points of dimension dim for  */
+/* n queries, passing undecided queries to exact, which is called with the  */
+/* index of the query.                                                       */
+template<class Exact>
+void batch(const double * const *P, size_t points, size_t dim, double *det,
+           size_t n, filter f, bool inclusive, Exact exact)
+{
+  block B;
+  for(size_t start=0; start < n; start += lanes) {
+    size_t m=n-start < lanes ? n-start : lanes;
+    gather(B,P,points,dim,start,m);
+    FPU_ROUND_DOUBLE;
+    f(B);
+    FPU_RESTORE;
+    for(size_t k=0; k < m; ++k)
+      det[start+k]=decided(B,k,inclusive) ? B.det[k] : exact(start+k);
+  }
+}
+
+#ifdef HAVE_AVX2_DISPATCH
+filter choose(filter scalar, filter avx2)
+{
+  static const bool supported=__builtin_cpu_supports("avx2");
+  return supported ? avx2 : scalar;
+}
+#else
+inline filter choose(filter scalar, filter)
+{
+  return scalar;
+}
+#endif
+
+#ifndef HAVE_AVX2_DISPATCH
+#define orient2dfilterAVX2 orient2dfilter
+#define orient3dfilterAVX2 orient3dfilter
+#define incirclefilterAVX2 incirclefilter
+#define inspherefilterAVX2 inspherefilter
+#endif
+
+}
+
+void orient2d(const REAL *pa, const REAL *pb, const REAL *pc, REAL *det,
+              size_t n)
+{
+  struct exact {
+    const REAL *pa,*pb,*pc;
+    REAL operator()(size_t i) const {
+      return orient2d(pa+2*i,pb+2*i,pc+2*i);
+    }
+  } e={pa,pb,pc};
+  const double *P[]={pa,pb,pc};
+  batch(P,3,2,det,n,choose(orient2dfilter,orient2dfilterAVX2),true,e);
+}
+
+void orient3d(const REAL *pa, const REAL *pb, const REAL *pc, const REAL *pd,
+              REAL *det, size_t n)
+{
+  struct exact {
+    const REAL *pa,*pb,*pc,*pd;
+    REAL operator()(size_t i) const {
+      return orient3d(pa+3*i,pb+3*i,pc+3*i,pd+3*i);
+    }
+  } e={pa,pb,pc,pd};
+  const double *P[]={pa,pb,pc,pd};
+  batch(P,4,3,det,n,choose(orient3dfilter,orient3dfilterAVX2),false,e);
+}
+
+void incircle(const REAL *pa, const REAL *pb, const REAL *pc, const REAL *pd,
+              REAL *det, size_t n)
+{
+  struct exact {
+    const REAL *pa,*pb,*pc,*pd;
+    REAL operator()(size_t i) const {
+      return incircle(pa+2*i,pb+2*i,pc+2*i,pd+2*i);
+    }
+  } e={pa,pb,pc,pd};
+  const double *P[]={pa,pb,pc,pd};
+  batch(P,4,2,det,n,choose(incirclefilter,incirclefilterAVX2),false,e);
+}
+
+void insphere(const REAL *pa, const REAL *pb, const REAL *pc, const REAL *pd,
+              const REAL *pe, REAL *det, size_t n)
+{
+  struct exact {
+    const REAL *pa,*pb,*pc,*pd,*pe;
+    REAL operator()(size_t i) const {
+      return insphere(pa+3*i,pb+3*i,pc+3*i,pd+3*i,pe+3*i);
+    }
+  } e={pa,pb,pc,pd,pe};
+  const double *P[]={pa,pb,pc,pd,pe};
+  batch(P,5,3,det,n,choose(inspherefilter,inspherefilterAVX2),false,e);
+}
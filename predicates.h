@@ -1,6 +1,8 @@
 #ifndef PREDICATES_H
 #define PREDICATES_H
 
+#include <cstddef>
+
 double orient2d(const double* pa, const double* pb, const double* pc);
 double orient2d(double ax, double ay, double bx, double by, double cx,
                 double cy);
@@ -15,6 +17,19 @@ double incircle(double ax, double ay, double bx, double by, double cx,
 double insphere(const double *pa, const double *pb, const double *pc,
                 const double *pd, const double *pe);
 
+// Batched versions, evaluating each predicate for the n queries whose points
+// are stored consecutively (two or three coordinates apiece) in the input
+// arrays and storing the results in det. The results are identical to those
+// of the single-query versions.
+void orient2d(const double *pa, const double *pb, const double *pc,
+              double *det, size_t n);
+void orient3d(const double *pa, const double *pb, const double *pc,
+              const double *pd, double *det, size_t n);
+void incircle(const double *pa, const double *pb, const double *pc,
+              const double *pd, double *det, size_t n);
+void insphere(const double *pa, const double *pb, const double *pc,
+              const double *pd, const double *pe, double *det, size_t n);
+
 extern const double resulterrbound,ccwerrboundA,ccwerrboundB,ccwerrboundC,
   o3derrboundA,o3derrboundB,o3derrboundC,iccerrboundA,iccerrboundB,
   iccerrboundC,isperrboundA,isperrboundB,isperrboundC;
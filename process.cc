@@ -25,6 +25,15 @@
 
 #include "process.h"
 
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
 namespace camp {
 pen& defaultpen() {
   return processData().defaultpen;
@@ -937,6 +946,255 @@ void doUnrestrictedList() {
   e.e.list(0);
 }
 
+namespace {
+
+// Read a line from fd into s, returning false at end of input.
+bool readLine(int fd, string& s)
+{
+  s.clear();
+  char c;
+  for(;;) {
+    ssize_t n=read(fd,&c,1);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    if(c == '\n') return true;
+    s += c;
+  }
+}
+
+bool writeAll(int fd, const char *buf, size_t n)
+{
+  while(n > 0) {
+    ssize_t w=write(fd,buf,n);
+    if(w < 0) {
+      if(errno == EINTR) continue;
+      return false;
+    }
+    buf += w;
+    n -= w;
+  }
+  return true;
+}
+
+bool socketAddress(const string& name, sockaddr_un& addr)
+{
+  if(name.size() >= sizeof(addr.sun_path)) {
+    cerr << "socket name " << name << " is too long" << endl;
+    return false;
+  }
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  strcpy(addr.sun_path,name.c_str());
+  return true;
+}
+
+// Run the files of a request, with the output and diagnostics sent to fd.
+// This is called in a fresh child of the server, so that each request starts
+// from the translated modules of the server but keeps its settings,
+// processData, and pictures to itself. The options of the request are set
+// in place, in the setting objects that the cached modules refer to.
+void runRequest(int fd, const string& cwd, const std::vector<string>& args)
+{
+  int null=open("/dev/null",O_RDONLY);
+  if(null >= 0) {
+    dup2(null,STDIN_FILENO);
+    close(null);
+  }
+  dup2(fd,STDOUT_FILENO);
+  dup2(fd,STDERR_FILENO);
+  close(fd);
+
+  if(chdir(cwd.c_str()) != 0) {
+    cerr << "cannot change to directory " << cwd << endl;
+    exit(1);
+  }
+
+  int argc=(int) args.size()+1;
+  char **argv=new char*[argc+1];
+  argv[0]=argv0;
+  for(size_t i=0; i < args.size(); ++i)
+    argv[i+1]=StrdupNoGC(args[i]);
+  argv[argc]=NULL;
+
+  em.clear();
+  try {
+    setOptions(argc,argv);
+  } catch(handled_error) {
+    em.statusError();
+  }
+
+  int n=numArgs();
+  if(n == 0) {
+    cerr << "no files submitted" << endl;
+    exit(1);
+  }
+  for(int i=0; i < n; ++i) {
+    processFile(string(getArg(i)),n > 1);
+    try {
+      if(i < n-1)
+        setOptions(argc,argv);
+    } catch(handled_error) {
+      em.statusError();
+    }
+  }
+
+  if(getSetting<bool>("wait")) {
+    int status;
+    while(wait(&status) > 0);
+  }
+  exit(em.processStatus() ? 0 : 1);
+}
+
+// Return whether the peer connected on fd runs as the owner of the server,
+// the only user allowed to submit requests.
+bool trustedPeer(int fd)
+{
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t len=sizeof(cred);
+  return getsockopt(fd,SOL_SOCKET,SO_PEERCRED,&cred,&len) == 0 &&
+    cred.uid == geteuid();
+#else
+  uid_t uid;
+  gid_t gid;
+  return getpeereid(fd,&uid,&gid) == 0 && uid == geteuid();
+#endif
+}
+
+// Read a request from fd, run it, and report its exit status as the final
+// byte written to fd.
+void serveRequest(int fd)
+{
+  string cwd,arg;
+  std::vector<string> args;
+  if(!readLine(fd,cwd)) _exit(1);
+  while(readLine(fd,arg) && !arg.empty())
+    args.push_back(arg);
+
+  pid_t pid=fork();
+  if(pid == 0) runRequest(fd,cwd,args);
+
+  unsigned char code=1;
+  int status;
+  if(pid > 0) {
+    while(waitpid(pid,&status,0) < 0 && errno == EINTR);
+    if(WIFEXITED(status)) code=WEXITSTATUS(status);
+    else if(WIFSIGNALED(status)) code=128+WTERMSIG(status);
+  }
+  writeAll(fd,(const char *) &code,1);
+  close(fd);
+  _exit(0);
+}
+
+}
+
+void processServer(const string& name)
+{
+  sockaddr_un addr;
+  if(!socketAddress(name,addr)) {
+    em.statusError();
+    return;
+  }
+
+  // Translate plain and the modules imported by the given files once.
+  runString("");
+  for(int i=0, n=numArgs(); i < n; ++i)
+    processFile(string(getArg(i)),true);
+  if(!em.processStatus()) return;
+
+  int fd=socket(AF_UNIX,SOCK_STREAM,0);
+  struct stat buf;
+  if(lstat(name.c_str(),&buf) == 0 && S_ISSOCK(buf.st_mode))
+    unlink(name.c_str());
+  // Only the owner may connect to the socket, which is never accessible to
+  // other users, even briefly.
+  mode_t mask=umask(077);
+  bool bound=fd >= 0 && bind(fd,(sockaddr *) &addr,sizeof(addr)) == 0;
+  umask(mask);
+  if(!bound || chmod(name.c_str(),0600) != 0 ||
+     listen(fd,SOMAXCONN) != 0) {
+    cerr << "cannot listen on socket " << name << ": " << strerror(errno)
+         << endl;
+    em.statusError();
+    return;
+  }
+  if(verbose > 0)
+    cerr << "Listening on " << name << endl;
+
+  for(;;) {
+    int conn=accept(fd,NULL,NULL);
+    while(waitpid(-1,NULL,WNOHANG) > 0);
+    if(conn < 0) {
+      if(errno == EINTR) continue;
+      cerr << "accept failed: " << strerror(errno) << endl;
+      break;
+    }
+    if(!trustedPeer(conn)) {
+      cerr << "rejected connection from another user" << endl;
+      close(conn);
+      continue;
+    }
+    pid_t pid=fork();
+    if(pid == 0) {
+      close(fd);
+      serveRequest(conn);
+    }
+    close(conn);
+  }
+  close(fd);
+  em.statusError();
+}
+
+int processClient(const string& name, int argc, char *argv[])
+{
+  sockaddr_un addr;
+  if(!socketAddress(name,addr)) return 1;
+  int fd=socket(AF_UNIX,SOCK_STREAM,0);
+  if(fd < 0 || connect(fd,(sockaddr *) &addr,sizeof(addr)) != 0) {
+    cerr << "cannot connect to server on " << name << ": " << strerror(errno)
+         << endl;
+    return 1;
+  }
+
+  ostringstream request;
+  request << getPath() << "\n";
+  for(int i=1; i < argc; ++i) {
+    string arg=argv[i];
+    size_t dash=arg.find_first_not_of('-');
+    if(dash == 1 || dash == 2) {
+      string option=arg.substr(dash);
+      if(option == "client") {++i; continue;}
+      if(option.compare(0,7,"client=") == 0) continue;
+    }
+    request << arg << "\n";
+  }
+  request << "\n";
+  string s=request.str();
+  if(!writeAll(fd,s.c_str(),s.size())) {
+    cerr << "cannot send request to " << name << endl;
+    return 1;
+  }
+
+  // The final byte received is the exit status of the request.
+  char data[BUFSIZ+1];
+  size_t held=0;
+  for(;;) {
+    ssize_t n=read(fd,data+held,BUFSIZ);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) break;
+    n += held;
+    writeAll(STDOUT_FILENO,data,n-1);
+    data[0]=data[n-1];
+    held=1;
+  }
+  close(fd);
+  if(held == 0) {
+    cerr << "server on " << name << " closed the connection" << endl;
+    return 1;
+  }
+  return (unsigned char) data[0];
+}
+
 // Environment class used by external programs linking to the shared library.
 class fullenv : public gc {
   penv pe;
@@ -44,6 +44,15 @@ void runPromptEmbedded(trans::coenv &e, istack &s);
 // Basic listing.
 void doUnrestrictedList();
 
+// Translate plain and the given files once, then run each request received
+// on the Unix socket in a forked process with its own settings and
+// processData.
+void processServer(const string& socket);
+
+// Submit the arguments to a server, relaying its output, and return the exit
+// status of the request.
+int processClient(const string& socket, int argc, char *argv[]);
+
 template<class T>
 class terminator {
 public:  
@@ -83,9 +92,19 @@ public:
 
 class texstream : public iopipestream {
 public:
+  string jobname; // Job name of an auxiliary pipe, or empty for texput.
   ~texstream();
 };
 
+// An auxiliary TeX pipe, started with the same preamble as the main TeX
+// pipe, used to measure labels concurrently.
+struct texworker {
+  texstream tex;
+  camp::pen lastpen;
+  size_t synced; // Number of entries of TeXpipelog already sent to tex.
+  texworker() : lastpen(camp::initialpen), synced(0) {}
+};
+
 typedef std::pair<size_t,size_t> linecolumn;
 typedef mem::map<CONST linecolumn,string> xkey_t;
 typedef mem::deque<camp::transform> xtransform_t;
@@ -95,6 +114,9 @@ struct processDataStruct {
   texstream tex; // Bi-directional pipe to latex (to find label bbox)
   mem::list<string> TeXpipepreamble;
   mem::list<string> TeXpreamble;
+  mem::list<string> TeXpipeinitial; // Preamble used to start the TeX pipe.
+  mem::vector<string> TeXpipelog;   // TeX code since sent to the TeX pipe.
+  mem::vector<texworker *> texworkers;
   vm::callable *atExitFunction;
   vm::callable *atUpdateFunction;
   vm::callable *atBreakpointFunction;
@@ -123,6 +145,15 @@ struct processDataStruct {
     currentpen=camp::pen();
   }
   
+  ~processDataStruct() {
+    closetexworkers();
+  }
+  
+  void closetexworkers() {
+    for(size_t i=0; i < texworkers.size(); ++i)
+      delete texworkers[i];
+    texworkers.clear();
+  }
 };
 
 processDataStruct &processData();
@@ -315,6 +315,14 @@ class profiler : public gc {
     topnode().nsecs += timeAndResetLap();
   }
 
+  // Number of times each opcode was executed immediately after another in
+  // the same function, indexed by the pair of opcodes.  A call to a builtin
+  // does not separate a pair, as the builtin runs no instructions.  Used to
+  // choose the superinstructions in program::fuse.
+  typedef std::pair<int,int> oppair;
+  mem::map<oppair, long long> pairs;
+  int lastop;
+
 public:
   profiler();
 
@@ -322,9 +330,9 @@ public:
   void endFunction(lambda *func);
   void beginFunction(bltin func);
   void endFunction(bltin func);
-  void recordInstruction();
+  void recordInstruction(inst::opcode op);
 
-  // TODO: Add position, type of instruction info to profiling.
+  // TODO: Add position info to profiling.
 
   // Dump all of the data out in a format that can be read into Python.
   void pydump(ostream &out);
@@ -332,10 +340,12 @@ public:
   // Dump all of the data in a format for kcachegrind.
   void dump(ostream& out);
 
+  // Dump the opcode pair counts, most frequent first.
+  void dumpPairs(ostream& out);
 };
 
 inline profiler::profiler()
-  : emptynode()
+  : emptynode(), lastop(-1)
 {
     callstack.push(&emptynode);
     startLap();
@@ -346,6 +356,7 @@ inline void profiler::beginFunction(lambda *func) {
   assert(!callstack.empty());
 
   recordTime();
+  lastop = -1;
 
   callstack.push(topnode().getChild(func));
   ++topnode().calls;
@@ -357,6 +368,7 @@ inline void profiler::endFunction(lambda *func) {
   assert(topnode().func == func);
 
   recordTime();
+  lastop = -1;
 
   callstack.pop();
 }
@@ -381,9 +393,12 @@ inline void profiler::endFunction(bltin cfunc) {
   callstack.pop();
 }
 
-inline void profiler::recordInstruction() {
+inline void profiler::recordInstruction(inst::opcode op) {
   assert(!callstack.empty());
   ++topnode().instructions;
+  if (lastop >= 0)
+    ++pairs[oppair(lastop, op)];
+  lastop = op;
 }
 
 inline void profiler::pydump(ostream& out) {
@@ -428,6 +443,26 @@ inline void profiler::dump(ostream& out) {
   }
 }
 
+inline void profiler::dumpPairs(ostream& out) {
+  static const char* opnames[] = {
+#define OPCODE(name, type) #name,
+#include "opcodes.h"
+#undef OPCODE
+  };
+
+  std::multimap<long long, oppair, std::greater<long long> > sorted;
+  for (mem::map<oppair, long long>::iterator i = pairs.begin();
+       i != pairs.end();
+       ++i)
+    sorted.insert(std::make_pair(i->second, i->first));
+
+  for (std::multimap<long long, oppair,
+         std::greater<long long> >::iterator i = sorted.begin();
+       i != sorted.end();
+       ++i)
+    out << i->first << " " << opnames[i->second.first] << " "
+        << opnames[i->second.second] << "\n";
+}
 
 } // namespace vm
 
@@ -27,10 +27,21 @@ public:
   label end();
   inst &back();
   void pop_back();
+  // Fuse common pairs of new instructions into superinstructions.
+  void fuse();
+#ifdef THREADED_DISPATCH
+  // Resolve the interpreter handler of each new instruction, indexed by
+  // opcode.
+  void thread(void *const *handlers);
+#endif
 private:
   friend class label;
   typedef mem::vector<inst> code_t;
   code_t code;
+  size_t fused; // Number of instructions examined for fusion.
+#ifdef THREADED_DISPATCH
+  size_t threaded; // Number of instructions with resolved handlers.
+#endif
   inst& operator[](size_t);
 };
 
@@ -64,16 +75,40 @@ void printInst(std::ostream& out, const program::label& code,
 void print(std::ostream& out, program *base);
 
 // Inline forwarding functions for vm::program
+#ifdef THREADED_DISPATCH
 inline program::program()
-  : code() {}
+  : code(), fused(0), threaded(0) {}
+#else
+inline program::program()
+  : code(), fused(0) {}
+#endif
 inline program::label program::end()
 { return label(code.size(), this); }
 inline program::label program::begin()
 { return label(0, this); }
 inline inst& program::back()
 { return code.back(); }
+#ifdef THREADED_DISPATCH
 inline void program::pop_back()
-{ return code.pop_back(); }
+{
+  code.pop_back();
+  if(fused > code.size()) fused=code.size();
+  if(threaded > code.size()) threaded=code.size();
+}
+inline void program::thread(void *const *handlers)
+{
+  // fuse() lowers threaded when it rewrites an instruction whose handler was
+  // already resolved.
+  for(; threaded < code.size(); ++threaded)
+    code[threaded].handler=handlers[code[threaded].op];
+}
+#else
+inline void program::pop_back()
+{
+  code.pop_back();
+  if(fused > code.size()) fused=code.size();
+}
+#endif
 inline void program::encode(inst i)
 { code.push_back(i); }
 inline inst& program::operator[](size_t n)
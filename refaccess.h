@@ -41,6 +41,17 @@ public:
   void encode(action act, position pos, coder &e, frame *);
 };
 
+// Access refers to data of type T found by calling ref each time the code is
+// run, rather than when it is translated, such as a field of the current
+// processData. Translated modules are reused by later processes, so they
+// must not hold the address of data owned by an earlier one.
+template <class T, T *(*ref)()>
+class callRefAccess : public access {
+public:
+  void encode(action act, position pos, coder &e);
+  void encode(action act, position pos, coder &e, frame *);
+};
+
 template <class T>
 void pointerRead(vm::stack *s) {
   T *ptr=vm::pop<T *>(s);
@@ -55,6 +66,18 @@ void pointerWrite(vm::stack *s) {
   s->push(value);
 }
 
+template <class T, T *(*ref)()>
+void callRead(vm::stack *s) {
+  s->push(*ref());
+}
+
+template <class T, T *(*ref)()>
+void callWrite(vm::stack *s) {
+  T value=vm::pop<T>(s);
+  *ref()=value;
+  s->push(value);
+}
+
 template <class T>
 void refAccess<T>::encode(action act, position, coder &e)
 {
@@ -86,5 +109,33 @@ void refAccess<T>::encode(action act, position pos, coder &e, frame *)
   encode(act, pos, e);
 }
 
+template <class T, T *(*ref)()>
+void callRefAccess<T,ref>::encode(action act, position, coder &e)
+{
+  REGISTER_BLTIN(((bltin) callRead<T,ref>), "callRead");
+  REGISTER_BLTIN(((bltin) callWrite<T,ref>), "callWrite");
+
+  switch (act) {
+    case READ:
+      e.encode(vm::inst::builtin, (bltin) callRead<T,ref>);
+      break;
+    case WRITE:
+      e.encode(vm::inst::builtin, (bltin) callWrite<T,ref>);
+      break;
+    case CALL:
+      e.encode(vm::inst::builtin, (bltin) callRead<T,ref>);
+      e.encode(vm::inst::popcall);
+      break;
+  };
+}
+
+template <class T, T *(*ref)()>
+void callRefAccess<T,ref>::encode(action act, position pos, coder &e, frame *)
+{
+  // Get rid of the useless top frame.
+  e.encode(vm::inst::pop);
+  encode(act, pos, e);
+}
+
 }
 #endif
@@ -694,6 +694,11 @@ struct stringArraySetting : public itemSetting {
     : itemSetting(name, 0, "", "",
                   types::stringArray(), (item) defaultValue) {}
 
+  // Copy the default, which the array setting may be modified through.
+  void reset() {
+    value=(item) new array(*vm::get<array *>(defaultValue));
+  }
+
   bool getOption() {return true;}
 };
 
@@ -1055,6 +1060,13 @@ void initSettings() {
   if(initialize) {
     queryRegistry();
     initialize=false;
+  } else {
+    // Modules kept by the module cache refer to the existing setting
+    // objects, so restore their defaults in place instead of rebuilding them.
+    for(optionsMap_t::iterator opt=optionsMap.begin();
+        opt != optionsMap.end(); ++opt)
+      opt->second->reset();
+    return;
   }
 
   settingsModule=new types::dummyRecord(symbol::trans("settings"));
@@ -1120,6 +1132,9 @@ void initSettings() {
                            "Multisampling width for screen images", 4));
   addOption(new boolSetting("offscreen", 0,
                             "Use offscreen rendering",false));
+  addOption(new boolSetting("software", 0,
+                            "Render 3D images in software, without OpenGL",
+                            !havegl));
   addOption(new boolSetting("twosided", 0,
                             "Use two-sided 3D lighting model for rendering",
                             true));
@@ -1139,6 +1154,9 @@ void initSettings() {
                             "3D labels always face viewer by default", true));
   addOption(new boolSetting("threads", 0,
                             "Use POSIX threads for 3D rendering", !msdos));
+  addOption(new IntSetting("maxthreads", 0, "n",
+                           "Threads for parallel computations (0: one per CPU)",
+                           1));
   addOption(new boolSetting("fitscreen", 0,
                             "Fit rendered image to screen", true));
   addOption(new boolSetting("interactiveWrite", 0,
@@ -1170,6 +1188,11 @@ void initSettings() {
 
   addOption(new boolSetting("twice", 0,
                             "Run LaTeX twice (to resolve references)"));
+  addOption(new IntSetting("texprocesses", 0, "n",
+                           "Number of TeX processes used to measure labels",
+                           1));
+  addOption(new boolSetting("labelcache", 0,
+                            "Cache TeX label metrics and outlines across runs"));
   addOption(new boolSetting("inlinetex", 0, "Generate inline TeX code"));
   addOption(new boolSetting("embed", 0, "Embed rendered preview image", true));
   addOption(new boolSetting("auto3D", 0, "Automatically activate 3D scene",
@@ -1238,6 +1261,10 @@ void initSettings() {
                             "Wait for child processes to finish before exiting"));
   addOption(new IntSetting("inpipe", 0, "n","",-1));
   addOption(new IntSetting("outpipe", 0, "n","",-1));
+  addOption(new stringSetting("server", 0, "socket",
+                              "Run files submitted to Unix socket"));
+  addOption(new stringSetting("client", 0, "socket",
+                              "Submit files to server on Unix socket"));
   addOption(new boolSetting("exitonEOF", 0, "Exit interactive mode on EOF",
                             true));
                             
@@ -1253,6 +1280,9 @@ void initSettings() {
   addOption(new boolSetting("autoplain", 0,
                             "Enable automatic importing of plain",
                             true));
+  addOption(new boolSetting("modulecache", 0,
+                            "Reuse translated modules across runs",
+                            true));
   addOption(new boolSetting("autorotate", 0,
                             "Enable automatic PDF page rotation",
                             false));
@@ -1589,6 +1619,18 @@ string texprogram()
   return path.empty() ? engine : (string) (path+"/"+engine);
 }
 
+unsigned int threadCount()
+{
+#ifdef HAVE_PTHREAD
+  Int n=getSetting<Int>("maxthreads");
+  if(n > 0) return (unsigned int) n;
+  long cpus=sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (unsigned int) cpus : 1;
+#else
+  return 1;
+#endif
+}
+
 Int getScroll() 
 {
   Int scroll=settings::getSetting<Int>("scroll");
@@ -60,6 +60,7 @@ extern const string suffix;
 extern const string guisuffix;
 extern const string standardprefix;
   
+extern string initdir;
 extern string historyname;
   
 void SetPageDimensions();
@@ -92,6 +93,9 @@ int numArgs();
 char *getArg(int n);
  
 Int getScroll();
+
+// Number of threads to use for parallel computations.
+unsigned int threadCount();
   
 extern mode_t mask;
   
@@ -168,6 +168,9 @@ void dumpProfile() {
   std::ofstream out("asyprof");
   if (!out.fail())
     prof.dump(out);
+  std::ofstream pairs("asyprof.pairs");
+  if (!pairs.fail())
+    prof.dumpPairs(pairs);
 }
 #endif
 
@@ -337,48 +340,79 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
   position& topPos=processData().topPos;
   string& fileName=processData().fileName;
 
-  try {
-    for (;;) {
-      const inst &i = *ip;
-      curPos = i.pos;
-      
-  if(curPos.filename() == fileName)
-    topPos=curPos;
-  
 #ifdef PROFILE
-      prof.recordInstruction();
+#  define RECORD_INSTRUCTION prof.recordInstruction(ip->op);
+#else
+#  define RECORD_INSTRUCTION
+#endif
+
+  // Bookkeeping done before each instruction.
+#define FETCH                                                   \
+  curPos = ip->pos;                                             \
+  if(curPos.filename() == fileName)                             \
+    topPos=curPos;                                              \
+  RECORD_INSTRUCTION                                            \
+  if(settings::verbose > 4) em.trace(curPos);                   \
+  if(!bplist.empty()) debug();                                  \
+  if(errorstream::interrupt) throw interrupted();
+
+  // Advance to the second instruction of a superinstruction.
+#define STEP ++ip; FETCH;
+
+  l->code->fuse();
+
+#ifdef THREADED_DISPATCH
+  static void *const handlers[] = {
+#define OPCODE(name,type) &&op_##name,
+#include "opcodes.h"
+#undef OPCODE
+  };
+  l->code->thread(handlers);
+
+#  define OP(name) op_##name
+#  define DISPATCH { FETCH; goto *ip->handler; }
+#  define NEXT { ++ip; DISPATCH; }
+#  define JUMP { ip = get<program::label>(*ip); DISPATCH; }
+#else
+#  define OP(name) case inst::name
+#  define NEXT break
+#  define JUMP { ip = get<program::label>(*ip); continue; }
 #endif
 
+  try {
+#ifdef THREADED_DISPATCH
+    DISPATCH;
+    {
+      {
+#else
+    for (;;) {
+      FETCH;
+
 #ifdef DEBUG_STACK
       printInst(cout, ip, l->code->begin());
       cout << "    (";
-			i.pos.printTerse(cout);
+			ip->pos.printTerse(cout);
 			cout << ")\n";
 #endif
 
-      if(settings::verbose > 4) em.trace(curPos);
-      
-      if(!bplist.empty()) debug();
-      
-      if(errorstream::interrupt) throw interrupted();
-      
-      switch (i.op)
+      switch (ip->op)
         {
-          case inst::varpush:
-            push(VAR(get<Int>(i)));
-            break;
+#endif
+          OP(varpush):
+            push(VAR(get<Int>(*ip)));
+            NEXT;
 
-          case inst::varsave:
-            VAR(get<Int>(i)) = top();
-            break;
+          OP(varsave):
+            VAR(get<Int>(*ip)) = top();
+            NEXT;
         
 #ifdef COMBO
-          case inst::varpop:
-            VAR(get<Int>(i)) = pop();
-            break;
+          OP(varpop):
+            VAR(get<Int>(*ip)) = pop();
+            NEXT;
 #endif
 
-          case inst::ret: {
+          OP(ret): {
             if (vars == 0)
               // Delete the frame from the stack.
               // TODO: Optimize for common cases.
@@ -387,74 +421,74 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
             return;
           }
 
-          case inst::pushframe:
+          OP(pushframe):
           {
             assert(vars);
-            Int size = get<Int>(i);
+            Int size = get<Int>(*ip);
             vars=make_pushframe(size, vars);
 
             SET_VARLINK;
 
-            break;
+            NEXT;
           }
 
-          case inst::popframe:
+          OP(popframe):
           {
             assert(vars);
             vars=get<frame *>(VAR(0));
 
             SET_VARLINK;
 
-            break;
+            NEXT;
           }
 
-          case inst::pushclosure:
+          OP(pushclosure):
             assert(vars);
             push(vars);
-            break; 
+            NEXT; 
 
-          case inst::nop:
-            break;
+          OP(nop):
+            NEXT;
 
-          case inst::pop:
+          OP(pop):
             pop();
-            break;
+            NEXT;
         
-          case inst::intpush:
-          case inst::constpush:
-            push(i.ref);
-            break;
+          OP(intpush):
+          OP(constpush):
+            push(ip->ref);
+            NEXT;
         
-          case inst::fieldpush: {
+          OP(fieldpush): {
             vars_t frame = pop<vars_t>();
             if (!frame)
               error("dereference of null pointer");
-            push(FRAMEVAR(frame, get<Int>(i)));
-            break;
+            push(FRAMEVAR(frame, get<Int>(*ip)));
+            NEXT;
           }
         
-          case inst::fieldsave: {
+          OP(fieldsave): {
             vars_t frame = pop<vars_t>();
             if (!frame)
               error("dereference of null pointer");
-            FRAMEVAR(frame, get<Int>(i)) = top();
-            break;
+            FRAMEVAR(frame, get<Int>(*ip)) = top();
+            NEXT;
           }
 
 #if COMBO
-          case inst::fieldpop: {
+          OP(fieldpop): {
 #error NOT REIMPLEMENTED
             vars_t frame = pop<vars_t>();
             if (!frame)
               error("dereference of null pointer");
-            FRAMEVAR(get<Int>(i)) = pop();
-            break;
+            FRAMEVAR(get<Int>(*ip)) = pop();
+            NEXT;
           }
 #endif
         
         
-          case inst::builtin: {
-            bltin func = get<bltin>(i);
+          OP(builtin): {
+            bltin func = get<bltin>(*ip);
 #ifdef PROFILE
             prof.beginFunction(func);
 #endif
@@ -462,75 +496,104 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
 #ifdef PROFILE
             prof.endFunction(func);
 #endif
-            break;
+            NEXT;
           }
 
-          case inst::jmp:
-            ip = get<program::label>(i);
-            continue;
+          OP(jmp):
+            JUMP;
 
-          case inst::cjmp:
-            if (pop<bool>()) { ip = get<program::label>(i); continue; }
-            break;
+          OP(cjmp):
+            if (pop<bool>()) JUMP;
+            NEXT;
 
-          case inst::njmp:
-            if (!pop<bool>()) { ip = get<program::label>(i); continue; }
-            break;
+          OP(njmp):
+            if (!pop<bool>()) JUMP;
+            NEXT;
 
-          case inst::jump_if_not_default:
-            if (!isdefault(pop())) { ip = get<program::label>(i); continue; }
-            break;
+          OP(jump_if_not_default):
+            if (!isdefault(pop())) JUMP;
+            NEXT;
 
 #ifdef COMBO
-          case inst::gejmp: {
+          OP(gejmp): {
             Int y = pop<Int>();
             Int x = pop<Int>();
             if (x>=y)
-              { ip = get<program::label>(i); continue; }
-            break;
+              JUMP;
+            NEXT;
           }
 
 #if 0
-          case inst::jump_if_func_eq: {
+          OP(jump_if_func_eq): {
             callable * b=pop<callable *>();
             callable * a=pop<callable *>();
             if (a->compare(b))
-              { ip = get<program::label>(i); continue; }
-            break;
+              JUMP;
+            NEXT;
           }
 
-          case inst::jump_if_func_neq: {
+          OP(jump_if_func_neq): {
             callable * b=pop<callable *>();
             callable * a=pop<callable *>();
             if (!a->compare(b))
-              { ip = get<program::label>(i); continue; }
-            break;
+              JUMP;
+            NEXT;
           }
 #endif
 #endif
 
-          case inst::push_default:
+          OP(push_default):
             push(Default);
-            break;
+            NEXT;
+
+          // Superinstructions (see program::fuse).
+          OP(varfieldpush): {
+            vars_t frame = get<vars_t>(VAR(get<Int>(*ip)));
+            STEP;
+            if (!frame)
+              error("dereference of null pointer");
+            push(FRAMEVAR(frame, get<Int>(*ip)));
+            NEXT;
+          }
 
-          case inst::popcall: {
+          OP(constbuiltin):
+            push(ip->ref);
+            STEP;
+            get<bltin>(*ip)(this);
+            NEXT;
+
+          OP(builtincjmp):
+            get<bltin>(*ip)(this);
+            STEP;
+            if (pop<bool>()) JUMP;
+            NEXT;
+
+          OP(builtinnjmp):
+            get<bltin>(*ip)(this);
+            STEP;
+            if (!pop<bool>()) JUMP;
+            NEXT;
+
+          OP(popcall): {
             /* get the function reference off of the stack */
             callable* f = pop<callable*>();
             f->call(this);
-            break;
+            NEXT;
           }
 
-          case inst::makefunc: {
+          OP(makefunc): {
             func *f = new func;
             f->closure = pop<vars_t>();
-            f->body = get<lambda*>(i);
+            f->body = get<lambda*>(*ip);
 
             push((callable*)f);
-            break;
+            NEXT;
           }
         
+#ifndef THREADED_DISPATCH
           default:
             error("Internal VM error: Bad stack operand");
+#endif
         }
 
 #ifdef DEBUG_STACK
@@ -539,7 +602,9 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
       cerr << "\n";
 #endif
             
+#ifndef THREADED_DISPATCH
       ++ip;
+#endif
     }
   } catch (bad_item_value&) {
     error("Trying to use uninitialized value.");
@@ -548,6 +613,15 @@ void stack::runWithOrWithoutClosure(lambda *l, vars_t vars, vars_t parent)
 #undef SET_VARLINK
 #undef VAR
 #undef FRAMEVAR
+#undef RECORD_INSTRUCTION
+#undef FETCH
+#undef STEP
+#undef OP
+#undef NEXT
+#undef JUMP
+#ifdef THREADED_DISPATCH
+#undef DISPATCH
+#endif
 }
 
 void stack::load(string index) {
@@ -0,0 +1,443 @@
+/*****
+ * stroke.cc
+ *
+ * Outlines of the region PostScript paints when stroking a path with a pen:
+ * offset curves, joins, caps, miter limits, and dash patterns.
+ *****/
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "stroke.h"
+#include "angle.h"
+
+namespace camp {
+
+namespace {
+
+// Accuracy of the offset curves, relative to the half width of the pen.
+const double fuzz=1.0e-3;
+
+// Depth to which a segment is subdivided in fitting its offset curves.
+const int maxdepth=12;
+
+struct cubic {
+  pair z0,c0,c1,z1;
+  bool straight;
+
+  cubic() {}
+  cubic(pair z0, pair c0, pair c1, pair z1, bool straight=false)
+    : z0(z0), c0(c0), c1(c1), z1(z1), straight(straight) {}
+
+  pair point(double t) const {
+    double s=1.0-t;
+    return s*s*s*z0+3.0*s*t*(s*c0+t*c1)+t*t*t*z1;
+  }
+
+  pair tangent(double t) const {
+    double s=1.0-t;
+    pair d=s*s*(c0-z0)+2.0*s*t*(c1-c0)+t*t*(z1-c1);
+    if(d != 0.0) return d;
+    d=s*(c1-2.0*c0+z0)+t*(z1-2.0*c1+c0);
+    return d != 0.0 ? d : z1-z0;
+  }
+
+  pair startdir() const {
+    return unit(c0 != z0 ? c0-z0 : c1 != z0 ? c1-z0 : z1-z0);
+  }
+
+  pair enddir() const {
+    return unit(z1 != c1 ? z1-c1 : z1 != c0 ? z1-c0 : z1-z0);
+  }
+
+  bool degenerate() const {
+    return z0 == c0 && z0 == c1 && z0 == z1;
+  }
+
+  cubic reverse() const {
+    return cubic(z1,c1,c0,z0,straight);
+  }
+
+  // Split at t=1/2.
+  void split(cubic& a, cubic& b) const {
+    pair m0=0.5*(z0+c0);
+    pair m1=0.5*(c0+c1);
+    pair m2=0.5*(c1+z1);
+    pair m3=0.5*(m0+m1);
+    pair m4=0.5*(m1+m2);
+    pair m=0.5*(m3+m4);
+    a=cubic(z0,m0,m3,m,straight);
+    b=cubic(m,m4,m2,z1,straight);
+  }
+};
+
+typedef std::vector<cubic> cubics;
+
+inline pair normal(pair v)
+{
+  return pair(-v.gety(),v.getx());
+}
+
+cubic line(pair a, pair b)
+{
+  pair d=third*(b-a);
+  return cubic(a,a+d,b-d,b,true);
+}
+
+// Return the cyclic path through the (contiguous) cubics.
+path closed(const cubics& c)
+{
+  size_t n=c.size();
+  mem::vector<solvedKnot> nodes(n);
+  for(size_t i=0; i < n; ++i) {
+    solvedKnot& k=nodes[i];
+    k.point=c[i].z0;
+    k.post=c[i].c0;
+    k.straight=c[i].straight;
+    nodes[(i+1) % n].pre=c[i].c1;
+  }
+  return path(nodes,n,true);
+}
+
+// Append cubics approximating the circular arc about c from c+v, turning
+// counterclockwise through angle a.
+void arc(cubics& q, pair c, pair v, double a)
+{
+  int n=std::max((int) ceil(fabs(a)/(0.5*PI)),1);
+  double step=a/n;
+  double k=4.0/3.0*tan(0.25*step);
+  pair r=expi(step);
+  for(int i=0; i < n; ++i) {
+    pair w=v*r;
+    q.push_back(cubic(c+v,c+v+k*normal(v),c+w-k*normal(w),c+w));
+    v=w;
+  }
+}
+
+// Return a cubic approximating the curve offset a distance h to the left of
+// b, with end control points matching the derivative of the offset, which
+// is that of b scaled by 1-h*curvature. Set reversed if the offset runs
+// backwards, where the curvature exceeds 1/h.
+cubic offset(const cubic& b, double h, bool& reversed)
+{
+  pair P0=b.z0+h*normal(b.startdir());
+  pair P3=b.z1+h*normal(b.enddir());
+  pair d0=b.c0-b.z0;
+  pair d1=b.z1-b.c1;
+  double k0=1.0, k1=1.0;
+  if(!b.straight) {
+    if(d0 != 0.0) {
+      double l=length(d0);
+      k0 -= h*2.0/3.0*cross(d0,b.c1-2.0*b.c0+b.z0)/(l*l*l);
+    }
+    if(d1 != 0.0) {
+      double l=length(d1);
+      k1 -= h*2.0/3.0*cross(d1,b.z1-2.0*b.c1+b.c0)/(l*l*l);
+    }
+  }
+  reversed=k0 < 0.0 || k1 < 0.0 || dot(P3-P0,b.z1-b.z0) < 0.0;
+  return cubic(P0,P0+k0*d0,P3-k1*d1,P3,b.straight);
+}
+
+// Check whether o is within tol of the offset of b by h.
+bool fits(const cubic& o, const cubic& b, double h, double tol)
+{
+  static const double T[]={0.25,0.5,0.75};
+  for(size_t i=0; i < 3; ++i) {
+    double t=T[i];
+    pair e=b.point(t)+h*normal(unit(b.tangent(t)));
+    if((o.point(t)-e).abs2() > tol*tol) return false;
+  }
+  return true;
+}
+
+// A piece of a segment, with its left and right offsets.
+struct piece {
+  cubic c,l,r;
+  bool lreversed,rreversed;
+};
+
+// Subdivide b until both of its offsets by h fit to within tol, appending
+// the pieces; offsets that still do not fit at the maximum depth are
+// replaced by their chords.
+void fit(std::vector<piece>& pieces, const cubic& b, double h, double tol,
+         int depth=0)
+{
+  piece p;
+  p.c=b;
+  p.l=offset(b,h,p.lreversed);
+  p.r=offset(b,-h,p.rreversed);
+  if(!b.straight && !(fits(p.l,b,h,tol) && fits(p.r,b,-h,tol))) {
+    if(depth < maxdepth) {
+      cubic l,r;
+      b.split(l,r);
+      fit(pieces,l,h,tol,depth+1);
+      fit(pieces,r,h,tol,depth+1);
+      return;
+    }
+    p.l=line(p.l.z0,p.l.z1);
+    p.r=line(p.r.z0,p.r.z1);
+  }
+  pieces.push_back(p);
+}
+
+// Return the signed area of the control polygon of the cyclic cubics.
+double area(const cubics& q)
+{
+  double a=0.0;
+  for(cubics::const_iterator p=q.begin(); p != q.end(); ++p)
+    a += cross(p->z0,p->c0)+cross(p->c0,p->c1)+cross(p->c1,p->z1);
+  return 0.5*a;
+}
+
+class stroker {
+  mem::vector<path>& outlines;
+  double h;
+  Int cap;
+  Int join;
+  double miterlimit;
+
+  // Every outline winds clockwise, so that overlapping ones never cancel.
+  void emit(cubics& q, bool counterclockwise=false) {
+    if(q.empty()) return;
+    if(counterclockwise) {
+      std::reverse(q.begin(),q.end());
+      for(cubics::iterator p=q.begin(); p != q.end(); ++p)
+        *p=p->reverse();
+    }
+    outlines.push_back(closed(q));
+  }
+
+  // The region between c and a parallel curve o, traversed from o.z0 to
+  // o.z1 in the opposite direction, as for the inside of a bend tighter
+  // than the pen, where the normals from c to o cross: this is a pair of
+  // triangles meeting where they do.
+  void lobes(const cubic& c, const cubic& o) {
+    pair u=o.z0-c.z0;
+    pair v=o.z1-c.z1;
+    pair w=c.z1-c.z0;
+    double denom=cross(u,v);
+    double s=denom != 0.0 ? cross(w,v)/denom : -1.0;
+    double t=denom != 0.0 ? cross(w,u)/denom : -1.0;
+    cubics q;
+    if(s >= 0.0 && s <= 1.0 && t >= 0.0 && t <= 1.0) {
+      pair x=c.z0+s*u;
+      q.push_back(c);
+      q.push_back(line(c.z1,x));
+      q.push_back(line(x,c.z0));
+      emit(q,area(q) > 0.0);
+      q.clear();
+      q.push_back(line(x,o.z1));
+      q.push_back(o.reverse());
+      q.push_back(line(o.z0,x));
+    } else {
+      q.push_back(c);
+      q.push_back(line(c.z1,o.z1));
+      q.push_back(o.reverse());
+      q.push_back(line(o.z0,c.z0));
+    }
+    emit(q,area(q) > 0.0);
+  }
+
+  // The region between l and r, traversed from left to right.
+  void band(const cubic& l, const cubic& r) {
+    cubics q;
+    q.push_back(l);
+    q.push_back(line(l.z1,r.z1));
+    q.push_back(r.reverse());
+    q.push_back(line(r.z0,l.z0));
+    emit(q);
+  }
+
+  // The region swept by the pen along b. Where the pen is wider than the
+  // bend, one offset runs backwards, and the pieces there are outlined
+  // separately so that no part winds the wrong way.
+  void segment(const cubic& b) {
+    std::vector<piece> pieces;
+    fit(pieces,b,h,fuzz*h);
+
+    bool reversed=false;
+    for(size_t i=0; i < pieces.size(); ++i)
+      if(pieces[i].lreversed || pieces[i].rreversed) reversed=true;
+
+    if(!reversed) {
+      cubics q;
+      for(size_t i=0; i < pieces.size(); ++i)
+        q.push_back(pieces[i].l);
+      q.push_back(line(q.back().z1,pieces.back().r.z1));
+      for(size_t i=pieces.size(); i-- > 0;)
+        q.push_back(pieces[i].r.reverse());
+      q.push_back(line(pieces.front().r.z0,pieces.front().l.z0));
+      emit(q);
+      return;
+    }
+
+    for(size_t i=0; i < pieces.size(); ++i) {
+      const piece& p=pieces[i];
+      if(p.lreversed) lobes(p.c,p.l);
+      else if(!p.rreversed) {
+        band(p.l,p.r);
+        continue;
+      } else band(p.l,p.c);
+      if(p.rreversed) lobes(p.c,p.r);
+      else band(p.c,p.r);
+    }
+  }
+
+  // The wedge filling the gap on the outside of a join at z, between
+  // segments with unit tangents u and v.
+  void joint(pair z, pair u, pair v) {
+    double c=cross(u,v);
+    double d=dot(u,v);
+    if(d > 0 && fabs(c) <= fuzz) return;
+
+    // The outside is on the right for a left turn; a reversal is treated
+    // as a left turn.
+    double s=c >= 0 ? -1.0 : 1.0;
+    double angle=fabs(atan2(c,d));
+    pair nu=normal(u), nv=normal(v);
+    pair a=z+s*h*nu;
+    pair b=z+s*h*nv;
+
+    cubics q;
+    q.push_back(line(z,a));
+    if(join == 1)
+      arc(q,z,a-z,-s*angle);
+    else if(join == 0 && d > -1.0 && sqrt(0.5*(1.0+d))*miterlimit >= 1.0) {
+      pair m=z+s*h/(1.0+d)*(nu+nv);
+      q.push_back(line(a,m));
+      q.push_back(line(m,b));
+    } else
+      q.push_back(line(a,b));
+    q.push_back(line(b,z));
+    emit(q,s < 0);
+  }
+
+  // The cap at end z of an open path, where the unit vector u points away
+  // from the path.
+  void endcap(pair z, pair u) {
+    pair n=h*normal(u);
+    cubics q;
+    if(cap == 1) {
+      arc(q,z,-n,PI);
+      q.push_back(line(z+n,z-n));
+    } else if(cap == 2) {
+      q.push_back(line(z+n,z+n+h*u));
+      q.push_back(line(z+n+h*u,z-n+h*u));
+      q.push_back(line(z-n+h*u,z-n));
+      q.push_back(line(z-n,z+n));
+    }
+    emit(q,cap == 1);
+  }
+
+  // A subpath of zero length at z, oriented along unit vector u.
+  void spot(pair z, pair u) {
+    cubics q;
+    if(cap == 1)
+      arc(q,z,h*u,2.0*PI);
+    else if(cap == 2) {
+      pair n=h*normal(u);
+      u *= h;
+      q.push_back(line(z+u+n,z-u+n));
+      q.push_back(line(z-u+n,z-u-n));
+      q.push_back(line(z-u-n,z+u-n));
+      q.push_back(line(z+u-n,z+u+n));
+    }
+    emit(q,true);
+  }
+
+public:
+  stroker(mem::vector<path>& outlines, const pen& p)
+    : outlines(outlines), h(0.5*p.width()), cap(p.cap()), join(p.join()),
+      miterlimit(p.miter()) {}
+
+  bool empty() {return h <= 0.0;}
+
+  // Stroke g as a single subpath; u orients a subpath of zero length.
+  void stroke(const path& g, pair u, bool cycles) {
+    cubics segs;
+    Int n=g.length();
+    for(Int i=0; i < n; ++i) {
+      cubic b(g.point(i),g.postcontrol(i),g.precontrol(i+1),g.point(i+1),
+              g.straight(i));
+      if(!b.degenerate()) segs.push_back(b);
+    }
+
+    size_t m=segs.size();
+    if(m == 0) {
+      if(!cycles) spot(g.point((Int) 0),u);
+      return;
+    }
+
+    for(size_t i=0; i < m; ++i) {
+      segment(segs[i]);
+      if(i > 0)
+        joint(segs[i].z0,segs[i-1].enddir(),segs[i].startdir());
+    }
+
+    if(cycles)
+      joint(segs[0].z0,segs[m-1].enddir(),segs[0].startdir());
+    else {
+      endcap(segs[0].z0,-segs[0].startdir());
+      endcap(segs[m-1].z1,segs[m-1].enddir());
+    }
+  }
+};
+
+}
+
+void strokepath(mem::vector<path>& outlines, const path& g, const pen& p)
+{
+  stroker s(outlines,p);
+  if(g.size() == 0 || s.empty()) return;
+
+  pair u=g.length() > 0 ? unit(g.dir((Int) 0,1)) : pair(1,0);
+  if(u == 0.0) u=pair(1,0);
+
+  const LineType *linetype=p.linetype();
+  size_t n=linetype->pattern.size();
+  std::vector<double> pattern(n);
+  double sum=0.0;
+  for(size_t i=0; i < n; ++i)
+    sum += pattern[i]=fabs(vm::read<double>(linetype->pattern,i));
+
+  if(sum == 0.0) {
+    s.stroke(g,u,g.cyclic());
+    return;
+  }
+
+  // Find where the dash offset falls within the pattern, which alternates
+  // between drawn and undrawn dashes even when it has an odd number of
+  // entries.
+  double period=n % 2 ? 2.0*sum : sum;
+  double skip=fmod(linetype->offset,period);
+  if(skip < 0) skip += period;
+  size_t i=0;
+  bool on=true;
+  while(skip > 0.0 && skip >= pattern[i]) {
+    skip -= pattern[i];
+    i=(i+1) % n;
+    on=!on;
+  }
+
+  double L=g.arclength();
+  double a=0.0;
+  double remaining=pattern[i]-skip;
+  for(;;) {
+    double b=std::min(a+remaining,L);
+    if(on) {
+      double t0=g.arctime(a);
+      double t1=g.arctime(b);
+      pair v=unit(g.dir(t0));
+      s.stroke(g.subpath(t0,t1),v == 0.0 ? u : v,false);
+    }
+    if(a+remaining >= L) break;
+    a += remaining;
+    i=(i+1) % n;
+    on=!on;
+    remaining=pattern[i];
+  }
+}
+
+}
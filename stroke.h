@@ -0,0 +1,25 @@
+/*****
+ * stroke.h
+ *
+ * Outlines of the region PostScript paints when stroking a path with a pen:
+ * offset curves, joins, caps, miter limits, and dash patterns.
+ *****/
+
+#ifndef STROKE_H
+#define STROKE_H
+
+#include "path.h"
+#include "pen.h"
+
+namespace camp {
+
+// Append to outlines the cyclic paths whose union, under the nonzero fill
+// rule, is the region painted by stroking g with the linewidth, linecap,
+// linejoin, miterlimit, and (unadjusted) dash pattern of p. As in
+// PostScript, the pen transform is ignored. The outlines of the segments,
+// joins, and caps overlap; they are not merged into the stroke boundary.
+void strokepath(mem::vector<path>& outlines, const path& g, const pen& p);
+
+}
+
+#endif
@@ -0,0 +1,775 @@
+/*****
+ * swrender.cc
+ *
+ * Rasterize the triangles, lines, and points of a 3D picture in software,
+ * following the OpenGL fixed-function pipeline, so that a picture can be
+ * exported without an OpenGL context.
+ *****/
+
+#include <cmath>
+#include <cstring>
+
+#include "swrender.h"
+
+namespace camp {
+
+#ifdef HAVE_RENDER
+
+rasterizer *software=NULL;
+
+namespace {
+
+// Width and height of the tiles rendered independently by each thread.
+const int tilesize=128;
+
+// OpenGL's default global ambient light.
+const float globalAmbient=0.2;
+
+// Clip coordinates and attributes of a vertex: x, y, z, w, the eye normal,
+// and the RGBA colour.
+const size_t clipstride=11;
+
+inline double clamp(double x)
+{
+  return x < 0.0 ? 0.0 : (x > 1.0 ? 1.0 : x);
+}
+
+// Return the signed distances of the clip coordinates v inside the near
+// and far clipping planes.
+inline double nearplane(const double *v)
+{
+  return v[2]+v[3];
+}
+
+inline double farplane(const double *v)
+{
+  return v[3]-v[2];
+}
+
+typedef std::vector<double> polygon;
+
+// Clip the polygon a, with vertices of clipstride coordinates, to the side
+// of a plane where d is nonnegative (Sutherland-Hodgman).
+void clipPolygon(polygon& b, const polygon& a, double (*d)(const double *))
+{
+  b.clear();
+  size_t n=a.size()/clipstride;
+  for(size_t i=0; i < n; ++i) {
+    const double *u=&a[clipstride*i];
+    const double *v=&a[clipstride*((i+1) % n)];
+    double du=d(u);
+    double dv=d(v);
+    if(du >= 0.0) b.insert(b.end(),u,u+clipstride);
+    if((du >= 0.0) != (dv >= 0.0)) {
+      double t=du/(du-dv);
+      for(size_t k=0; k < clipstride; ++k)
+        b.push_back(u[k]+t*(v[k]-u[k]));
+    }
+  }
+}
+
+// Return the edge function of a, b at the point x, y; it is positive when
+// the point is to the left of a directed edge from a to b.
+inline double edge(const float *a, const float *b, double x, double y)
+{
+  return (b[0]-a[0])*(y-a[1])-(b[1]-a[1])*(x-a[0]);
+}
+
+// Points lying exactly on an edge belong to the triangle on its left if
+// the edge is a left or top edge of that triangle, so that pixels on edges
+// shared by two triangles are drawn once.
+inline bool topleft(const float *a, const float *b)
+{
+  double dy=b[1]-a[1];
+  return dy < 0.0 || (dy == 0.0 && b[0] < a[0]);
+}
+
+}
+
+rasterizer::rasterizer(int width, int height, const double *Background) :
+  width(width), height(height), twosided(true), depthmask(true),
+  pointsize(1.0)
+{
+  for(size_t i=0; i < 4; ++i)
+    background[i]=Background[i];
+
+  for(size_t i=0; i < 16; ++i)
+    P[i]=T[i]=(i % 5 == 0);
+  for(size_t i=0; i < 9; ++i)
+    N[i]=(i % 4 == 0);
+
+  static const float white[]={1.0,1.0,1.0,1.0};
+  static const float black[]={0.0,0.0,0.0,1.0};
+  static const float grey[]={0.8,0.8,0.8,1.0};
+  static const float darkgrey[]={0.2,0.2,0.2,1.0};
+  memcpy(s.diffuse,grey,sizeof(grey));
+  memcpy(s.ambient,darkgrey,sizeof(darkgrey));
+  memcpy(s.emission,black,sizeof(black));
+  memcpy(s.specular,black,sizeof(black));
+  s.shininess=0.0;
+  s.colormaterial=false;
+  s.emissive=false;
+
+  current[0]=current[1]=0.0;
+  current[2]=1.0;
+  memcpy(current+3,white,sizeof(white));
+}
+
+rasterizer::~rasterizer()
+{
+  for(size_t i=0; i < batches.size(); ++i)
+    delete batches[i];
+}
+
+void rasterizer::ortho(double left, double right, double bottom, double top,
+                       double zNear, double zFar)
+{
+  for(size_t i=0; i < 16; ++i)
+    P[i]=0.0;
+  P[0]=2.0/(right-left);
+  P[3]=-(right+left)/(right-left);
+  P[5]=2.0/(top-bottom);
+  P[7]=-(top+bottom)/(top-bottom);
+  P[10]=-2.0/(zFar-zNear);
+  P[11]=-(zFar+zNear)/(zFar-zNear);
+  P[15]=1.0;
+}
+
+void rasterizer::frustum(double left, double right, double bottom, double top,
+                         double zNear, double zFar)
+{
+  for(size_t i=0; i < 16; ++i)
+    P[i]=0.0;
+  P[0]=2.0*zNear/(right-left);
+  P[2]=(right+left)/(right-left);
+  P[5]=2.0*zNear/(top-bottom);
+  P[6]=(top+bottom)/(top-bottom);
+  P[10]=-(zFar+zNear)/(zFar-zNear);
+  P[11]=-2.0*zFar*zNear/(zFar-zNear);
+  P[14]=-1.0;
+}
+
+void rasterizer::loadModelview(const double *t)
+{
+  for(size_t i=0; i < 4; ++i)
+    for(size_t j=0; j < 4; ++j)
+      T[4*i+j]=t[4*j+i];
+
+  // The normal matrix is the inverse transpose of the upper 3x3 block, up
+  // to a positive factor: the cofactor matrix divided by the determinant.
+  double a=T[0], b=T[1], c=T[2];
+  double d=T[4], e=T[5], f=T[6];
+  double g=T[8], h=T[9], k=T[10];
+  double A=e*k-f*h, B=f*g-d*k, C=d*h-e*g;
+  double det=a*A+b*B+c*C;
+  double s=det < 0.0 ? -1.0 : 1.0;
+  N[0]=s*A; N[1]=s*B; N[2]=s*C;
+  N[3]=s*(c*h-b*k); N[4]=s*(a*k-c*g); N[5]=s*(b*g-a*h);
+  N[6]=s*(b*f-c*e); N[7]=s*(c*d-a*f); N[8]=s*(a*e-b*d);
+}
+
+void rasterizer::modelview(double *t) const
+{
+  for(size_t i=0; i < 4; ++i)
+    for(size_t j=0; j < 4; ++j)
+      t[4*j+i]=T[4*i+j];
+}
+
+void rasterizer::addLight(const triple& position, const double *diffuse,
+                          const double *ambient, const double *specular)
+{
+  light L;
+  double x=position.getx(), y=position.gety(), z=position.getz();
+  triple d=unit(triple(T[0]*x+T[1]*y+T[2]*z,T[4]*x+T[5]*y+T[6]*z,
+                       T[8]*x+T[9]*y+T[10]*z));
+  triple h=unit(d+triple(0.0,0.0,1.0));
+  L.direction[0]=d.getx(); L.direction[1]=d.gety(); L.direction[2]=d.getz();
+  L.half[0]=h.getx(); L.half[1]=h.gety(); L.half[2]=h.getz();
+  for(size_t i=0; i < 4; ++i) {
+    L.diffuse[i]=diffuse[i];
+    L.ambient[i]=ambient[i];
+    L.specular[i]=specular[i];
+  }
+  lights.push_back(L);
+}
+
+void rasterizer::material(GLenum pname, const GLfloat *params)
+{
+  float *dest;
+  switch(pname) {
+    case GL_DIFFUSE:
+      dest=s.diffuse;
+      break;
+    case GL_AMBIENT:
+      dest=s.ambient;
+      break;
+    case GL_EMISSION:
+      dest=s.emission;
+      break;
+    case GL_SPECULAR:
+      dest=s.specular;
+      break;
+    default:
+      return;
+  }
+  for(size_t i=0; i < 4; ++i)
+    dest[i]=params[i];
+}
+
+rasterizer::batch *rasterizer::add(kind type)
+{
+  batch *b=new batch;
+  b->type=type;
+  b->s=s;
+  b->depthmask=depthmask;
+  b->size=pointsize;
+  batches.push_back(b);
+  clip.clear();
+  return b;
+}
+
+GLuint rasterizer::store(batch *b, const double *v)
+{
+  std::vector<float>& V=b->vertices;
+  GLuint index=V.size()/stride;
+  double w=v[3];
+  if(w > 0.0) {
+    double q=1.0/w;
+    V.push_back((v[0]*q+1.0)*0.5*width);
+    V.push_back((v[1]*q+1.0)*0.5*height);
+    V.push_back((v[2]*q+1.0)*0.5);
+    V.push_back(q);
+    for(size_t k=4; k < clipstride; ++k)
+      V.push_back(v[k]*q);
+  } else V.resize(V.size()+stride);
+  return index;
+}
+
+void rasterizer::transform(batch *b, const GLfloat *v, const GLfloat *n,
+                           const GLfloat *c)
+{
+  double e[4];
+  for(size_t i=0; i < 4; ++i) {
+    const double *Ti=T+4*i;
+    e[i]=Ti[0]*v[0]+Ti[1]*v[1]+Ti[2]*v[2]+Ti[3];
+  }
+
+  double V[clipstride];
+  for(size_t i=0; i < 4; ++i) {
+    const double *Pi=P+4*i;
+    V[i]=Pi[0]*e[0]+Pi[1]*e[1]+Pi[2]*e[2]+Pi[3]*e[3];
+  }
+  for(size_t i=0; i < 3; ++i) {
+    const double *Ni=N+3*i;
+    V[4+i]=Ni[0]*n[0]+Ni[1]*n[1]+Ni[2]*n[2];
+  }
+  for(size_t i=0; i < 4; ++i)
+    V[7+i]=c[i];
+
+  clip.insert(clip.end(),V,V+clipstride);
+  store(b,V);
+}
+
+void rasterizer::clipTriangle(batch *b, GLuint i, GLuint j, GLuint k)
+{
+  const double *u=&clip[clipstride*i];
+  const double *v=&clip[clipstride*j];
+  const double *w=&clip[clipstride*k];
+
+  if(nearplane(u) >= 0.0 && nearplane(v) >= 0.0 && nearplane(w) >= 0.0 &&
+     farplane(u) >= 0.0 && farplane(v) >= 0.0 && farplane(w) >= 0.0 &&
+     u[3] > 0.0 && v[3] > 0.0 && w[3] > 0.0) {
+    b->indices.push_back(i);
+    b->indices.push_back(j);
+    b->indices.push_back(k);
+    return;
+  }
+
+  polygon a(u,u+clipstride);
+  a.insert(a.end(),v,v+clipstride);
+  a.insert(a.end(),w,w+clipstride);
+  polygon c;
+  clipPolygon(c,a,nearplane);
+  clipPolygon(a,c,farplane);
+
+  size_t n=a.size()/clipstride;
+  if(n < 3) return;
+  std::vector<GLuint> index(n);
+  for(size_t m=0; m < n; ++m)
+    index[m]=store(b,&a[clipstride*m]);
+  for(size_t m=2; m < n; ++m) {
+    b->indices.push_back(index[0]);
+    b->indices.push_back(index[m-1]);
+    b->indices.push_back(index[m]);
+  }
+}
+
+void rasterizer::clipLine(batch *b, GLuint i, GLuint j)
+{
+  const double *u=&clip[clipstride*i];
+  const double *v=&clip[clipstride*j];
+  double t0=0.0, t1=1.0;
+  double (*planes[])(const double *)={nearplane,farplane};
+  for(size_t p=0; p < 2; ++p) {
+    double du=planes[p](u);
+    double dv=planes[p](v);
+    if(du < 0.0 && dv < 0.0) return;
+    if(du < 0.0) t0=std::max(t0,du/(du-dv));
+    else if(dv < 0.0) t1=std::min(t1,du/(du-dv));
+  }
+  if(t0 > t1) return;
+
+  if(t0 == 0.0 && t1 == 1.0) {
+    b->indices.push_back(i);
+    b->indices.push_back(j);
+    return;
+  }
+
+  double U[clipstride],V[clipstride];
+  for(size_t k=0; k < clipstride; ++k) {
+    U[k]=u[k]+t0*(v[k]-u[k]);
+    V[k]=u[k]+t1*(v[k]-u[k]);
+  }
+  b->indices.push_back(store(b,U));
+  b->indices.push_back(store(b,V));
+}
+
+void rasterizer::addTriangles(const GLfloat *buffer, const GLuint *indices,
+                              size_t n, bool colors, bool colormaterial)
+{
+  if(n == 0) return;
+  batch *b=add(TRIANGLES);
+  b->s.colormaterial=colormaterial;
+
+  // Transform the vertices that are used.
+  GLuint nvertices=0;
+  for(size_t i=0; i < n; ++i)
+    nvertices=std::max(nvertices,indices[i]+1);
+  size_t Stride=colors ? 10 : 6;
+  b->vertices.reserve(stride*nvertices);
+  clip.reserve(clipstride*nvertices);
+  for(GLuint i=0; i < nvertices; ++i) {
+    const GLfloat *v=buffer+Stride*i;
+    transform(b,v,v+3,colors ? v+6 : current+3);
+  }
+
+  b->indices.reserve(n);
+  for(size_t i=0; i+2 < n; i += 3)
+    clipTriangle(b,indices[i],indices[i+1],indices[i+2]);
+}
+
+void rasterizer::triangles(const GLfloat *buffer, const GLuint *indices,
+                           size_t n, bool colors)
+{
+  addTriangles(buffer,indices,n,colors,colors);
+}
+
+void rasterizer::lines(const GLfloat *buffer, const GLuint *indices, size_t n)
+{
+  if(n == 0) return;
+  batch *b=add(LINES);
+
+  GLuint nvertices=0;
+  for(size_t i=0; i < n; ++i)
+    nvertices=std::max(nvertices,indices[i]+1);
+  for(GLuint i=0; i < nvertices; ++i)
+    transform(b,buffer+3*i,current,current+3);
+
+  for(size_t i=0; i+1 < n; i += 2)
+    clipLine(b,indices[i],indices[i+1]);
+}
+
+void rasterizer::point(const GLfloat *v, const GLfloat *c)
+{
+  batch *b=add(POINTS);
+  transform(b,v,current,c);
+  const double *V=&clip[0];
+  if(nearplane(V) >= 0.0 && farplane(V) >= 0.0 && V[3] > 0.0)
+    b->indices.push_back(0);
+}
+
+void rasterizer::normal(GLfloat x, GLfloat y, GLfloat z)
+{
+  current[0]=x;
+  current[1]=y;
+  current[2]=z;
+}
+
+void rasterizer::color(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+  current[3]=r;
+  current[4]=g;
+  current[5]=b;
+  current[6]=a;
+}
+
+void rasterizer::vertex(GLfloat x, GLfloat y, GLfloat z)
+{
+  immediate.push_back(x);
+  immediate.push_back(y);
+  immediate.push_back(z);
+  immediate.insert(immediate.end(),current,current+7);
+}
+
+void rasterizer::endTriangles()
+{
+  size_t n=immediate.size()/10;
+  std::vector<GLuint> indices(n);
+  for(size_t i=0; i < n; ++i)
+    indices[i]=i;
+  if(n > 0)
+    addTriangles(&immediate[0],&indices[0],n,true,s.colormaterial);
+  immediate.clear();
+}
+
+// Evaluate the OpenGL lighting equation for directional lights and a
+// viewer at infinity, with the eye normal n and vertex colour c.
+void rasterizer::shade(float *rgba, const shading& S, const float *n,
+                       const float *c, bool back) const
+{
+  const float *diffuse=S.diffuse;
+  const float *ambient=S.ambient;
+  const float *emission=S.emission;
+  if(S.colormaterial) {
+    if(S.emissive) emission=c;
+    else diffuse=ambient=c;
+  }
+
+  double nx=n[0], ny=n[1], nz=n[2];
+  double norm=sqrt(nx*nx+ny*ny+nz*nz);
+  if(norm > 0.0) {
+    double s=(back && twosided) ? -1.0/norm : 1.0/norm;
+    nx *= s;
+    ny *= s;
+    nz *= s;
+  }
+
+  double r=emission[0]+globalAmbient*ambient[0];
+  double g=emission[1]+globalAmbient*ambient[1];
+  double b=emission[2]+globalAmbient*ambient[2];
+
+  for(size_t i=0; i < lights.size(); ++i) {
+    const light& L=lights[i];
+    r += ambient[0]*L.ambient[0];
+    g += ambient[1]*L.ambient[1];
+    b += ambient[2]*L.ambient[2];
+    const float *d=L.direction;
+    double dot=nx*d[0]+ny*d[1]+nz*d[2];
+    if(dot > 0.0) {
+      r += dot*diffuse[0]*L.diffuse[0];
+      g += dot*diffuse[1]*L.diffuse[1];
+      b += dot*diffuse[2]*L.diffuse[2];
+      const float *h=L.half;
+      double spec=nx*h[0]+ny*h[1]+nz*h[2];
+      if(spec > 0.0) {
+        spec=std::pow(spec,(double) S.shininess);
+        r += spec*S.specular[0]*L.specular[0];
+        g += spec*S.specular[1]*L.specular[1];
+        b += spec*S.specular[2]*L.specular[2];
+      }
+    }
+  }
+
+  rgba[0]=clamp(r);
+  rgba[1]=clamp(g);
+  rgba[2]=clamp(b);
+  rgba[3]=clamp(diffuse[3]);
+}
+
+inline void rasterizer::blend(float *p, const float *rgba)
+{
+  float a=rgba[3];
+  float b=1.0-a;
+  for(size_t i=0; i < 4; ++i)
+    p[i]=a*rgba[i]+b*p[i];
+}
+
+// Interpolate the attributes of three vertices perspective-correctly with
+// the barycentric coordinates l, and shade the result.
+void rasterizer::rasterizeTriangle(const batch *B, const float *v0,
+                                   const float *v1, const float *v2,
+                                   tile& T)
+{
+  double area=edge(v0,v1,v2[0],v2[1]);
+  if(!(area != 0.0)) return;
+  bool back=area < 0.0;
+  if(back) {
+    std::swap(v1,v2);
+    area=-area;
+  }
+
+  double xmin=std::min(std::min(v0[0],v1[0]),v2[0]);
+  double xmax=std::max(std::max(v0[0],v1[0]),v2[0]);
+  double ymin=std::min(std::min(v0[1],v1[1]),v2[1]);
+  double ymax=std::max(std::max(v0[1],v1[1]),v2[1]);
+  int x0=(int) std::max(ceil(xmin-0.5),(double) T.x0);
+  int x1=(int) std::min(floor(xmax-0.5),(double) T.x1);
+  int y0=(int) std::max(ceil(ymin-0.5),(double) T.y0);
+  int y1=(int) std::min(floor(ymax-0.5),(double) T.y1);
+
+  bool t0=topleft(v1,v2);
+  bool t1=topleft(v2,v0);
+  bool t2=topleft(v0,v1);
+  double inv=1.0/area;
+  const shading& S=B->s;
+
+  for(int y=y0; y <= y1; ++y) {
+    double py=y+0.5;
+    for(int x=x0; x <= x1; ++x) {
+      double px=x+0.5;
+      double w0=edge(v1,v2,px,py);
+      double w1=edge(v2,v0,px,py);
+      double w2=edge(v0,v1,px,py);
+      if(w0 < 0.0 || w1 < 0.0 || w2 < 0.0) continue;
+      if((w0 == 0.0 && !t0) || (w1 == 0.0 && !t1) || (w2 == 0.0 && !t2))
+        continue;
+      double l0=w0*inv, l1=w1*inv, l2=w2*inv;
+      size_t pixel=T.pixel(x,y);
+      float z=l0*v0[2]+l1*v1[2]+l2*v2[2];
+      if(!(z < T.depth[pixel])) continue;
+
+      double q=1.0/(l0*v0[3]+l1*v1[3]+l2*v2[3]);
+      float a[7];
+      for(size_t k=0; k < 7; ++k)
+        a[k]=(l0*v0[4+k]+l1*v1[4+k]+l2*v2[4+k])*q;
+      float rgba[4];
+      shade(rgba,S,a,a+3,back);
+      blend(T.pixels+4*pixel,rgba);
+      if(B->depthmask) T.depth[pixel]=z;
+    }
+  }
+}
+
+void rasterizer::rasterizeLine(const batch *B, const float *v0,
+                               const float *v1, tile& T)
+{
+  double dx=v1[0]-v0[0];
+  double dy=v1[1]-v0[1];
+  bool xmajor=fabs(dx) >= fabs(dy);
+  double d=xmajor ? dx : dy;
+  if(d == 0.0) return;
+
+  // Step along the major axis through the pixel centres.
+  double a0=xmajor ? v0[0] : v0[1];
+  double a1=xmajor ? v1[0] : v1[1];
+  double lower=xmajor ? T.x0 : T.y0;
+  double upper=xmajor ? T.x1 : T.y1;
+  int i0=(int) std::max(ceil(std::min(a0,a1)-0.5),lower);
+  int i1=(int) std::min(floor(std::max(a0,a1)-0.5),upper);
+  const shading& S=B->s;
+
+  for(int i=i0; i <= i1; ++i) {
+    double t=(i+0.5-a0)/d;
+    int j=(int) floor((xmajor ? v0[1]+t*dy : v0[0]+t*dx));
+    int x=xmajor ? i : j;
+    int y=xmajor ? j : i;
+    if(!T.inside(x,y)) continue;
+    size_t pixel=T.pixel(x,y);
+    float z=v0[2]+t*(v1[2]-v0[2]);
+    if(!(z < T.depth[pixel])) continue;
+
+    double q0=(1.0-t)*v0[3];
+    double q1=t*v1[3];
+    double q=1.0/(q0+q1);
+    float a[7];
+    for(size_t k=0; k < 7; ++k)
+      a[k]=((1.0-t)*v0[4+k]+t*v1[4+k])*q;
+    float rgba[4];
+    shade(rgba,S,a,a+3,false);
+    blend(T.pixels+4*pixel,rgba);
+    if(B->depthmask) T.depth[pixel]=z;
+  }
+}
+
+void rasterizer::rasterizePoint(const batch *B, const float *v, tile& T)
+{
+  double r=0.5*B->size;
+  int x0=(int) std::max(ceil(v[0]-r-0.5),(double) T.x0);
+  int x1=(int) std::min(ceil(v[0]+r-0.5)-1.0,(double) T.x1);
+  int y0=(int) std::max(ceil(v[1]-r-0.5),(double) T.y0);
+  int y1=(int) std::min(ceil(v[1]+r-0.5)-1.0,(double) T.y1);
+  if(x0 > x1 || y0 > y1) return;
+  
+  double q=1.0/v[3];
+  float a[7];
+  for(size_t k=0; k < 7; ++k)
+    a[k]=v[4+k]*q;
+  float rgba[4];
+  shade(rgba,B->s,a,a+3,false);
+
+  for(int y=y0; y <= y1; ++y) {
+    for(int x=x0; x <= x1; ++x) {
+      size_t pixel=T.pixel(x,y);
+      if(!(v[2] < T.depth[pixel])) continue;
+      blend(T.pixels+4*pixel,rgba);
+      if(B->depthmask) T.depth[pixel]=v[2];
+    }
+  }
+}
+
+// Add the primitive at position index of batch b, with the window bounding
+// box x0,y0,x1,y1, to the bin of each tile that it overlaps.
+void rasterizer::bin(GLuint b, GLuint index, double x0, double y0, double x1,
+                     double y1)
+{
+  if(!(x1 >= 0.0 && y1 >= 0.0 && x0 < width && y0 < height)) return;
+  int i0=(int) std::max(floor(x0),0.0)/tilesize;
+  int i1=(int) std::min(floor(x1),width-1.0)/tilesize;
+  int j0=(int) std::max(floor(y0),0.0)/tilesize;
+  int j1=(int) std::min(floor(y1),height-1.0)/tilesize;
+  entry e={b,index};
+  for(int j=j0; j <= j1; ++j)
+    for(int i=i0; i <= i1; ++i)
+      bins[j*columns+i].push_back(e);
+}
+
+void rasterizer::bin()
+{
+  columns=(width+tilesize-1)/tilesize;
+  rows=(height+tilesize-1)/tilesize;
+  bins.assign(columns*rows,std::vector<entry>());
+  
+  for(size_t k=0; k < batches.size(); ++k) {
+    const batch *b=batches[k];
+    const float *V=b->vertices.empty() ? NULL : &b->vertices[0];
+    const std::vector<GLuint>& I=b->indices;
+    size_t n=I.size();
+    switch(b->type) {
+      case TRIANGLES:
+        for(size_t i=0; i+2 < n; i += 3) {
+          const float *v0=V+stride*I[i];
+          const float *v1=V+stride*I[i+1];
+          const float *v2=V+stride*I[i+2];
+          bin(k,i,std::min(std::min(v0[0],v1[0]),v2[0]),
+              std::min(std::min(v0[1],v1[1]),v2[1]),
+              std::max(std::max(v0[0],v1[0]),v2[0]),
+              std::max(std::max(v0[1],v1[1]),v2[1]));
+        }
+        break;
+      case LINES:
+        for(size_t i=0; i+1 < n; i += 2) {
+          const float *v0=V+stride*I[i];
+          const float *v1=V+stride*I[i+1];
+          bin(k,i,std::min(v0[0],v1[0]),std::min(v0[1],v1[1]),
+              std::max(v0[0],v1[0]),std::max(v0[1],v1[1]));
+        }
+        break;
+      case POINTS:
+        for(size_t i=0; i < n; ++i) {
+          const float *v=V+stride*I[i];
+          double r=0.5*b->size;
+          bin(k,i,v[0]-r,v[1]-r,v[0]+r,v[1]+r);
+        }
+        break;
+    }
+  }
+}
+
+// Render tile k into the output image.
+void rasterizer::render(size_t k, std::vector<float>& pixels,
+                        std::vector<float>& depth, unsigned char *data)
+{
+  tile T;
+  T.x0=(k % columns)*tilesize;
+  T.y0=(k/columns)*tilesize;
+  T.x1=std::min(T.x0+tilesize,width)-1;
+  T.y1=std::min(T.y0+tilesize,height)-1;
+  T.width=T.x1-T.x0+1;
+  size_t n=T.width*(T.y1-T.y0+1);
+  
+  pixels.resize(4*n);
+  for(size_t i=0; i < n; ++i)
+    for(size_t c=0; c < 4; ++c)
+      pixels[4*i+c]=background[c];
+  depth.assign(n,1.0);
+  T.pixels=&pixels[0];
+  T.depth=&depth[0];
+
+  const std::vector<entry>& Bin=bins[k];
+  for(size_t i=0; i < Bin.size(); ++i) {
+    const batch *b=batches[Bin[i].batch];
+    const float *V=&b->vertices[0];
+    const GLuint *I=&b->indices[Bin[i].index];
+    switch(b->type) {
+      case TRIANGLES:
+        rasterizeTriangle(b,V+stride*I[0],V+stride*I[1],V+stride*I[2],T);
+        break;
+      case LINES:
+        rasterizeLine(b,V+stride*I[0],V+stride*I[1],T);
+        break;
+      case POINTS:
+        rasterizePoint(b,V+stride*I[0],T);
+        break;
+    }
+  }
+
+  for(int y=T.y0; y <= T.y1; ++y) {
+    const float *p=&pixels[4*T.pixel(T.x0,y)];
+    unsigned char *d=data+3*((size_t) y*width+T.x0);
+    for(int x=0; x < T.width; ++x, p += 4, d += 3)
+      for(size_t c=0; c < 3; ++c)
+        d[c]=(unsigned char) (255.0*clamp(p[c])+0.5);
+  }
+}
+
+// Render every count-th tile, starting from tile start, with buffers
+// private to one thread.
+struct rastertask {
+  rasterizer *r;
+  unsigned char *data;
+  size_t start,count;
+
+  void run() {
+    std::vector<float> pixels,depth;
+    size_t n=r->bins.size();
+    for(size_t k=start; k < n; k += count)
+      r->render(k,pixels,depth,data);
+  }
+};
+
+#ifdef HAVE_PTHREAD
+void *runrastertask(void *task)
+{
+  ((rastertask *) task)->run();
+  return NULL;
+}
+#endif
+
+void rasterizer::finish(unsigned char *data, unsigned int threads)
+{
+  bin();
+
+  size_t ntiles=bins.size();
+  size_t count=std::max(std::min((size_t) threads,ntiles),(size_t) 1);
+  std::vector<rastertask> tasks(count);
+  for(size_t k=0; k < count; ++k) {
+    tasks[k].r=this;
+    tasks[k].data=data;
+    tasks[k].start=k;
+    tasks[k].count=count;
+  }
+
+#ifdef HAVE_PTHREAD
+  std::vector<pthread_t> thread(count);
+  std::vector<bool> started(count,false);
+  for(size_t k=1; k < count; ++k)
+    started[k]=pthread_create(&thread[k],NULL,runrastertask,&tasks[k]) == 0;
+  runrastertask(&tasks[0]);
+  for(size_t k=1; k < count; ++k) {
+    if(started[k]) pthread_join(thread[k],NULL);
+    else runrastertask(&tasks[k]);
+  }
+#else
+  for(size_t k=0; k < count; ++k)
+    tasks[k].run();
+#endif
+
+  bins.clear();
+  for(size_t i=0; i < batches.size(); ++i)
+    delete batches[i];
+  batches.clear();
+}
+
+#endif
+
+} //namespace camp
@@ -0,0 +1,197 @@
+/*****
+ * swrender.h
+ *
+ * Rasterize the triangles, lines, and points of a 3D picture in software,
+ * following the OpenGL fixed-function pipeline, so that a picture can be
+ * exported without an OpenGL context.
+ *****/
+
+#ifndef SWRENDER_H
+#define SWRENDER_H
+
+#include <vector>
+
+#include "common.h"
+#include "glrender.h"
+
+namespace camp {
+
+#ifdef HAVE_RENDER
+
+class rasterizer {
+public:
+  // Number of floats stored for each vertex in window coordinates: x, y,
+  // depth, 1/w, and the eye normal and colour, each divided by w.
+  static const size_t stride=11;
+
+  struct light {
+    float direction[3]; // Unit direction in eye coordinates.
+    float half[3];      // Unit half vector for a viewer along the z axis.
+    float diffuse[4];
+    float ambient[4];
+    float specular[4];
+  };
+
+  struct shading {
+    float diffuse[4];
+    float ambient[4];
+    float emission[4];
+    float specular[4];
+    float shininess;
+    bool colormaterial;
+    bool emissive;      // Vertex colours replace the emission.
+  };
+
+  enum kind {TRIANGLES,LINES,POINTS};
+
+  struct batch {
+    kind type;
+    shading s;
+    bool depthmask;
+    float size;         // Point size in pixels.
+    std::vector<float> vertices;
+    std::vector<GLuint> indices;
+  };
+
+  // A rectangle of the image, with its own RGBA colour and depth buffers.
+  struct tile {
+    int x0,y0,x1,y1;    // Inclusive pixel bounds.
+    int width;
+    float *pixels;
+    float *depth;
+    
+    size_t pixel(int x, int y) const {
+      return (size_t) (y-y0)*width+x-x0;
+    }
+    bool inside(int x, int y) const {
+      return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+    }
+  };
+
+  // The primitive of a batch whose first index is at the given position.
+  struct entry {
+    GLuint batch;
+    GLuint index;
+  };
+
+private:
+  int width,height;
+  float background[4];
+
+  double P[16];         // Projection matrix.
+  double T[16];         // Modelview matrix.
+  double N[9];          // Normal matrix.
+
+  std::vector<light> lights;
+  bool twosided;
+
+  shading s;
+  bool depthmask;
+  float pointsize;
+  std::vector<batch *> batches;
+
+  // The primitives overlapping each tile, in drawing order.
+  int columns,rows;
+  std::vector<std::vector<entry> > bins;
+
+  // Immediate-mode vertices, and the current normal and colour.
+  std::vector<GLfloat> immediate;
+  GLfloat current[7];
+
+  // Clip coordinates of the vertices of the batch being built.
+  std::vector<double> clip;
+
+  batch *add(kind type);
+  void transform(batch *b, const GLfloat *v, const GLfloat *n,
+                 const GLfloat *c);
+  GLuint store(batch *b, const double *v);
+  void addTriangles(const GLfloat *buffer, const GLuint *indices, size_t n,
+                    bool colors, bool colormaterial);
+  void clipTriangle(batch *b, GLuint i, GLuint j, GLuint k);
+  void clipLine(batch *b, GLuint i, GLuint j);
+
+  void shade(float *rgba, const shading& S, const float *n, const float *c,
+             bool back) const;
+  static void blend(float *p, const float *rgba);
+  void rasterizeTriangle(const batch *b, const float *v0, const float *v1,
+                         const float *v2, tile& T);
+  void rasterizeLine(const batch *b, const float *v0, const float *v1,
+                     tile& T);
+  void rasterizePoint(const batch *b, const float *v, tile& T);
+
+  void bin(GLuint b, GLuint index, double x0, double y0, double x1,
+           double y1);
+  void bin();
+  void render(size_t k, std::vector<float>& pixels, std::vector<float>& depth,
+              unsigned char *data);
+
+public:
+  rasterizer(int width, int height, const double *Background);
+  ~rasterizer();
+
+  // Set up a projection as glOrtho or glFrustum would.
+  void ortho(double left, double right, double bottom, double top,
+             double zNear, double zFar);
+  void frustum(double left, double right, double bottom, double top,
+               double zNear, double zFar);
+
+  // Load the modelview matrix t, in OpenGL's column-major format.
+  void loadModelview(const double *t);
+  void modelview(double *t) const;
+
+  // Add a directional light at the position (x,y,z,0), transformed by the
+  // current modelview matrix.
+  void addLight(const triple& position, const double *diffuse,
+                const double *ambient, const double *specular);
+  void clearLights() {lights.clear();}
+  void setTwoSided(bool b) {twosided=b;}
+
+  void material(GLenum pname, const GLfloat *params);
+  void materialShininess(GLfloat shininess) {s.shininess=shininess;}
+  void colorMaterial(GLenum mode) {s.emissive=mode == GL_EMISSION;}
+  void enableColorMaterial(bool b) {s.colormaterial=b;}
+  void setDepthMask(bool b) {depthmask=b;}
+  void setPointSize(float size) {pointsize=size;}
+
+  // Queue indexed triangles from a buffer of vertices with normals and,
+  // if colors is true, RGBA colours, as BezierPatch stores them.
+  void triangles(const GLfloat *buffer, const GLuint *indices, size_t n,
+                 bool colors);
+
+  // Queue indexed lines from a buffer of vertices, as BezierCurve stores
+  // them.
+  void lines(const GLfloat *buffer, const GLuint *indices, size_t n);
+
+  void point(const GLfloat *v, const GLfloat *c);
+
+  // Immediate-mode triangles.
+  void normal(GLfloat x, GLfloat y, GLfloat z);
+  void color(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+  void vertex(GLfloat x, GLfloat y, GLfloat z);
+  void endTriangles();
+
+  // Rasterize the queued primitives in tiles, which are divided among the
+  // given number of threads, and store the image in data as RGB bytes,
+  // starting from the bottom row.
+  void finish(unsigned char *data, unsigned int threads);
+
+  friend struct rastertask;
+};
+
+// The rasterizer in use, or NULL when rendering with OpenGL.
+extern rasterizer *software;
+
+// Store the current modelview matrix in t, in OpenGL's column-major format.
+inline void getModelview(double *t)
+{
+  if(software) software->modelview(t);
+#ifdef HAVE_GL
+  else glGetDoublev(GL_MODELVIEW_MATRIX,t);
+#endif
+}
+
+#endif
+
+} //namespace camp
+
+#endif
@@ -0,0 +1,308 @@
+/*****
+ * tablereader.cc
+ *
+ * Bulk reader for rows of reals from comma- or whitespace-separated text,
+ * optionally parsing ahead on a background thread.
+ *****/
+
+#include <cstdlib>
+
+#include "tablereader.h"
+#include "array.h"
+#include "camperror.h"
+
+namespace camp {
+
+namespace {
+
+// Size of the chunks read from the stream, extended to whole lines.
+const size_t chunkSize=1 << 20;
+
+// Powers of ten that are exactly representable as doubles.
+const double exactPowers[]={
+  1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,
+  1e16,1e17,1e18,1e19,1e20,1e21,1e22
+};
+
+inline bool blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+inline bool digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// Parse a real starting at p, returning a pointer just past it, or NULL if
+// p does not start a real. Decimal numbers with at most 19 significant
+// digits and small exponents are converted exactly without strtod; all
+// other forms (long mantissas, large exponents, inf, nan, hex) fall back to
+// strtod. The text must be terminated by a null character.
+const char *parseReal(const char *p, double& x)
+{
+  const char *start=p;
+  bool negative=false;
+  if(*p == '-' || *p == '+') negative=(*p++ == '-');
+
+  char *end;
+  if(p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    x=strtod(start,&end);
+    return end == start ? NULL : end;
+  }
+
+  unsigned long long m=0;
+  int digits=0;
+  int exponent=0;
+  bool any=false;
+  bool exact=true;
+
+  for(; digit(*p); ++p) {
+    any=true;
+    if(digits < 19) {
+      m=10*m+(*p-'0');
+      if(m) ++digits;
+    } else {
+      ++exponent;
+      if(*p != '0') exact=false;
+    }
+  }
+  if(*p == '.') {
+    for(++p; digit(*p); ++p) {
+      any=true;
+      if(digits < 19) {
+        m=10*m+(*p-'0');
+        if(m) ++digits;
+        --exponent;
+      } else if(*p != '0') exact=false;
+    }
+  }
+
+  if(any && (*p == 'e' || *p == 'E')) {
+    const char *q=p+1;
+    bool negexp=false;
+    if(*q == '-' || *q == '+') negexp=(*q++ == '-');
+    if(digit(*q)) {
+      int e=0;
+      for(; digit(*q); ++q)
+        if(e < 10000) e=10*e+(*q-'0');
+      exponent += negexp ? -e : e;
+      p=q;
+    }
+  }
+
+  if(any && exact && m < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+    double v=(double) m;
+    v=exponent < 0 ? v/exactPowers[-exponent] : v*exactPowers[exponent];
+    x=negative ? -v : v;
+    return p;
+  }
+
+  x=strtod(start,&end);
+  return end == start ? NULL : end;
+}
+
+}
+
+tablereader::tablereader(const string& name, istream *stream, char comment,
+                         bool csv, bool ahead) :
+  name(name), stream(stream), comment(comment), csv(csv), ahead(ahead),
+  row(0), line(0)
+#ifdef HAVE_PTHREAD
+  , pending(NULL)
+#endif
+{}
+
+tablereader::~tablereader()
+{
+#ifdef HAVE_PTHREAD
+  if(pending) join();
+#endif
+  for(std::deque<block*>::iterator p=parsed.begin(); p != parsed.end(); ++p)
+    delete *p;
+}
+
+tablereader::block *tablereader::readChunk()
+{
+  if(!stream->good()) return NULL;
+  block *b=new block;
+  b->start=stream->tellg();
+  std::vector<char>& text=b->text;
+  text.resize(chunkSize);
+  stream->read(&text[0],chunkSize);
+  text.resize(stream->gcount());
+  if(stream->good() && !text.empty() && text.back() != '\n') {
+    int c;
+    while((c=stream->get()) != EOF) {
+      text.push_back((char) c);
+      if(c == '\n') break;
+    }
+  }
+  if(text.empty()) {
+    delete b;
+    return NULL;
+  }
+  text.push_back(0);
+  return b;
+}
+
+void tablereader::parse(block *b) const
+{
+  const char *p=&b->text[0];
+  const char *end=p+b->text.size()-1;
+  std::vector<double>& values=b->values;
+  values.reserve(b->text.size()/8);
+
+  while(p < end) {
+    ++b->lines;
+    while(blank(*p)) ++p;
+    if(*p == '\n' || *p == comment || p == end) {
+      while(p < end && *p++ != '\n');
+      continue;
+    }
+
+    for(;;) {
+      while(blank(*p)) ++p;
+      double x=0.0;
+      bool field=!(csv && *p == ',') && *p != '\n' && *p != comment &&
+        p != end;
+      if(field) {
+        const char *q=parseReal(p,x);
+        if(q == NULL || (!blank(*q) && *q != '\n' && *q != comment &&
+                         q != end && !(csv && *q == ','))) {
+          const char *e=p;
+          while(e < end && !blank(*e) && *e != '\n' && *e != ',') ++e;
+          b->error=string(p,e);
+          b->errorline=b->lines;
+          return;
+        }
+        p=q;
+        while(blank(*p)) ++p;
+      } else if(!csv) break;
+      values.push_back(x);
+      if(csv) {
+        if(*p != ',') break;
+        ++p;
+      }
+    }
+
+    while(p < end && *p++ != '\n');
+    b->ends.push_back(values.size());
+    b->next.push_back(p-&b->text[0]);
+  }
+  std::vector<char>().swap(b->text);
+}
+
+#ifdef HAVE_PTHREAD
+void *tablereader::parsePending(void *reader)
+{
+  tablereader *t=(tablereader *) reader;
+  t->parse(t->pending);
+  return NULL;
+}
+
+void tablereader::join()
+{
+  pthread_join(thread,NULL);
+  parsed.push_back(pending);
+  pending=NULL;
+}
+#endif
+
+bool tablereader::more()
+{
+#ifdef HAVE_PTHREAD
+  if(pending) {
+    join();
+    return true;
+  }
+#endif
+  block *b=readChunk();
+  if(!b) return false;
+  parse(b);
+  parsed.push_back(b);
+  return true;
+}
+
+void tablereader::readAhead()
+{
+#ifdef HAVE_PTHREAD
+  if(!ahead || pending) return;
+  block *b=readChunk();
+  if(!b) return;
+  pending=b;
+  if(pthread_create(&thread,NULL,parsePending,this) != 0) {
+    pending=NULL;
+    parse(b);
+    parsed.push_back(b);
+  }
+#endif
+}
+
+vm::array *tablereader::read(size_t n)
+{
+  vm::array *a=new vm::array(0);
+  while(n == 0 || a->size() < n) {
+    if(parsed.empty()) {
+      if(more()) continue;
+      break;
+    }
+    block *b=parsed.front();
+    if(row < b->ends.size()) {
+      size_t start=row == 0 ? 0 : b->ends[row-1];
+      size_t stop=b->ends[row];
+      vm::array *r=new vm::array(stop-start);
+      for(size_t i=start; i < stop; ++i)
+        (*r)[i-start]=b->values[i];
+      a->push(r);
+      ++row;
+      continue;
+    }
+    pop();
+  }
+  readAhead();
+  return a;
+}
+
+void tablereader::pop()
+{
+  block *b=parsed.front();
+  if(b->errorline) {
+    ostringstream buf;
+    buf << "invalid real '" << b->error << "' on line "
+        << line+b->errorline << " of file '" << name << "'";
+    reportError(buf);
+  }
+  line += b->lines;
+  parsed.pop_front();
+  delete b;
+  row=0;
+}
+
+bool tablereader::eof()
+{
+  for(;;) {
+    if(parsed.empty()) {
+      if(more()) continue;
+      return true;
+    }
+    block *b=parsed.front();
+    if(row < b->ends.size() || b->errorline) return false;
+    pop();
+  }
+}
+
+std::streamoff tablereader::tell() const
+{
+  if(!parsed.empty()) {
+    const block *b=parsed.front();
+    if(b->start < 0) return -1;
+    return b->start+(row == 0 ? 0 : b->next[row-1]);
+  }
+#ifdef HAVE_PTHREAD
+  if(pending) return pending->start;
+#endif
+  return stream->tellg();
+}
+
+}
@@ -0,0 +1,88 @@
+/*****
+ * tablereader.h
+ *
+ * Bulk reader for rows of reals from comma- or whitespace-separated text,
+ * optionally parsing ahead on a background thread.
+ *****/
+
+#ifndef TABLEREADER_H
+#define TABLEREADER_H
+
+#include <deque>
+#include <vector>
+
+#include "common.h"
+
+namespace vm {
+class array;
+}
+
+namespace camp {
+
+class tablereader {
+public:
+  // A block of parsed rows, read from a chunk of whole lines.
+  struct block {
+    std::vector<char> text;
+    std::vector<double> values;
+    std::vector<size_t> ends;  // End of each row in values.
+    std::vector<size_t> next;  // Offset in text of the line after each row.
+    std::streamoff start;      // Stream position of text, or -1.
+    size_t lines;              // Lines in text.
+    size_t errorline;          // Line of the first invalid value, from 1.
+    string error;
+
+    block() : start(-1), lines(0), errorline(0) {}
+  };
+
+private:
+  string name;
+  istream *stream;
+  char comment;
+  bool csv;
+  bool ahead;
+
+  std::deque<block*> parsed;
+  size_t row;                  // Next row of the front block.
+  size_t line;                 // Lines before the front block.
+
+#ifdef HAVE_PTHREAD
+  pthread_t thread;
+  block *pending;              // Block being parsed on thread.
+#endif
+
+  // Read the next chunk of whole lines from the stream, or return NULL at EOF.
+  block *readChunk();
+  void parse(block *b) const;
+
+  // Parse another block, returning false at EOF.
+  bool more();
+  // Discard the front block, reporting its first invalid value, if any.
+  void pop();
+  void readAhead();
+#ifdef HAVE_PTHREAD
+  static void *parsePending(void *reader);
+  void join();
+#endif
+
+public:
+  tablereader(const string& name, istream *stream, char comment, bool csv,
+              bool ahead);
+  ~tablereader();
+
+  bool csvMode() const {return csv;}
+
+  // Return up to n rows of reals, or all remaining rows if n is 0.
+  vm::array *read(size_t n);
+
+  // Return whether no rows remain, parsing ahead if necessary.
+  bool eof();
+
+  // Return the stream position of the first line not yet returned, or -1 if
+  // the stream is exhausted or cannot report positions.
+  std::streamoff tell() const;
+};
+
+}
+
+#endif